@@ -0,0 +1,457 @@
+// ----------------------------------
+// projects/deque/AsyncDequeChannel.h
+// ----------------------------------
+
+#ifndef AsyncDequeChannel_h
+#define AsyncDequeChannel_h
+
+#if __cplusplus < 202002L
+#error "AsyncDequeChannel.h needs C++20 coroutines"
+#endif
+
+// --------
+// includes
+// --------
+
+#include <condition_variable> // condition_variable
+#include <coroutine>          // coroutine_handle, noop_coroutine, suspend_always, suspend_never
+#include <cstddef>            // size_t
+#include <exception>          // terminate
+#include <mutex>              // lock_guard, mutex, unique_lock
+#include <optional>           // optional
+#include <thread>             // thread
+#include <utility>            // move
+#include <vector>             // vector
+
+#include "Deque.h"
+
+// ----------------
+// channel_executor
+// ----------------
+
+/**
+ * Where a channel resumes the coroutines it wakes.
+ */
+class channel_executor {
+    public:
+        virtual ~channel_executor () {}
+
+        /**
+         * Arranges for h to be resumed later, never from inside this call.
+         */
+        virtual void schedule (std::coroutine_handle<> h) = 0;
+
+        /**
+         * Schedules n handles at once; executors that share a queue
+         * override it to take their lock and wake their threads once.
+         */
+        virtual void schedule_batch (const std::coroutine_handle<>* h, std::size_t n) {
+            for (std::size_t i = 0; i != n; ++i)
+                schedule(h[i]);}};
+
+// ----------------------
+// single_thread_executor
+// ----------------------
+
+/**
+ * Runs scheduled coroutines one at a time on the thread that calls run().
+ * Not thread-safe: everything that schedules must run on that thread.
+ */
+class single_thread_executor : public channel_executor {
+    private:
+        MyDeque< std::coroutine_handle<> > _ready;
+
+    public:
+        void schedule (std::coroutine_handle<> h) override {
+            _ready.push_back(h);}
+
+        /**
+         * Resumes scheduled coroutines until none are left.
+         * @return the number resumed
+         */
+        std::size_t run () {
+            std::size_t n = 0;
+            for (; !_ready.empty(); ++n) {
+                std::coroutine_handle<> h = _ready.front();
+                _ready.pop_front();
+                h.resume();}
+            return n;}};
+
+// --------------------
+// thread_pool_executor
+// --------------------
+
+/**
+ * Resumes scheduled coroutines on a fixed set of threads that share one
+ * MyDeque of ready handles. The destructor stops the threads once the queue
+ * is empty.
+ */
+class thread_pool_executor : public channel_executor {
+    private:
+        std::mutex                         _lock;
+        std::condition_variable            _wake;
+        MyDeque< std::coroutine_handle<> > _ready;
+        bool                               _stop;
+        std::vector<std::thread>           _threads;
+
+        void work () {
+            std::unique_lock<std::mutex> g(_lock);
+            for (;;) {
+                _wake.wait(g, [this] () {return _stop || !_ready.empty();});
+                if (_ready.empty())
+                    return;
+                std::coroutine_handle<> h = _ready.front();
+                _ready.pop_front();
+                g.unlock();
+                h.resume();
+                g.lock();}}
+
+    public:
+        /**
+         * @param n is the number of threads
+         */
+        explicit thread_pool_executor (std::size_t n) :
+                _stop(false) {
+            for (std::size_t i = 0; i != n; ++i)
+                _threads.push_back(std::thread([this] () {work();}));}
+
+        ~thread_pool_executor () {
+            {
+            std::lock_guard<std::mutex> g(_lock);
+            _stop = true;
+            }
+            _wake.notify_all();
+            for (std::size_t i = 0; i != _threads.size(); ++i)
+                _threads[i].join();}
+
+        void schedule (std::coroutine_handle<> h) override {
+            {
+            std::lock_guard<std::mutex> g(_lock);
+            _ready.push_back(h);
+            }
+            _wake.notify_one();}
+
+        void schedule_batch (const std::coroutine_handle<>* h, std::size_t n) override {
+            {
+            std::lock_guard<std::mutex> g(_lock);
+            for (std::size_t i = 0; i != n; ++i)
+                _ready.push_back(h[i]);
+            }
+            if (n == 1)
+                _wake.notify_one();
+            else if (n)
+                _wake.notify_all();}};
+
+// ------------
+// channel_task
+// ------------
+
+/**
+ * A fire-and-forget coroutine: it starts suspended, is started by spawn(),
+ * and frees itself when it finishes. An exception escaping it terminates.
+ */
+struct channel_task {
+    struct promise_type {
+        channel_task get_return_object () {
+            return channel_task{std::coroutine_handle<promise_type>::from_promise(*this)};}
+
+        std::suspend_always initial_suspend () noexcept {
+            return {};}
+
+        std::suspend_never final_suspend () noexcept {
+            return {};}
+
+        void return_void () {}
+
+        void unhandled_exception () {
+            std::terminate();}};
+
+    std::coroutine_handle<promise_type> handle;};
+
+/**
+ * Starts t on e.
+ */
+inline void spawn (channel_executor& e, channel_task t) {
+    e.schedule(t.handle);}
+
+// -----------------
+// AsyncDequeChannel
+// -----------------
+
+/**
+ * A FIFO channel between coroutines, holding its items in a MyDeque.
+ * co_await pop() takes the front item, suspending while there is none, and
+ * yields an empty optional once the channel is closed and drained.
+ * co_await push(v) suspends only while a bounded channel is full and yields
+ * false if the channel was closed first. Waiting coroutines queue in FIFO
+ * order and are resumed through the channel's executor; a push that finds a
+ * consumer waiting hands the item straight to it and transfers control to
+ * it symmetrically, rescheduling the producer, so the hand-off costs no trip
+ * through the executor's queue. push_range() and close() wake every waiter
+ * they release with one schedule_batch() call. Safe to use from several
+ * threads at once.
+ */
+template <typename T>
+class AsyncDequeChannel {
+    public:
+        // --------
+        // typedefs
+        // --------
+
+        typedef T           value_type;
+        typedef std::size_t size_type;
+
+        class pop_awaiter;
+        class push_awaiter;
+
+    private:
+        // ----
+        // data
+        // ----
+
+        std::mutex              _lock;
+        MyDeque<T>              _items;
+        MyDeque<pop_awaiter*>   _consumers; // waiting for an item
+        MyDeque<push_awaiter*>  _producers; // waiting for room
+        size_type               _capacity;  // 0 for unbounded
+        bool                    _closed;
+        channel_executor&       _executor;
+
+    private:
+        bool full () const {
+            return _capacity && _items.size() >= _capacity;}
+
+        /**
+         * With the lock held, takes the front item into a, letting one
+         * waiting producer in behind it; finishes a if the channel is closed
+         * and empty.
+         * @return true if a is finished, with the producer to resume in wake
+         */
+        bool take (pop_awaiter& a, std::coroutine_handle<>& wake) {
+            if (_items.empty())
+                return _closed;
+            a._value.emplace(std::move(_items.front()));
+            _items.pop_front();
+            if (!_producers.empty()) {
+                push_awaiter* p = _producers.front();
+                _producers.pop_front();
+                _items.push_back(std::move(p->_value));
+                p->_accepted = true;
+                wake = p->_h;}
+            return true;}
+
+    public:
+        // -----------
+        // pop_awaiter
+        // -----------
+
+        class pop_awaiter {
+            private:
+                friend class AsyncDequeChannel;
+
+                AsyncDequeChannel*      _c;
+                std::optional<T>        _value;
+                std::coroutine_handle<> _h;
+
+            public:
+                explicit pop_awaiter (AsyncDequeChannel* c) :
+                        _c(c)
+                    {}
+
+                bool await_ready () {
+                    std::coroutine_handle<> wake;
+                    bool done;
+                    {
+                    std::lock_guard<std::mutex> g(_c->_lock);
+                    done = _c->take(*this, wake);
+                    }
+                    if (wake)
+                        _c->_executor.schedule(wake);
+                    return done;}
+
+                bool await_suspend (std::coroutine_handle<> h) {
+                    std::coroutine_handle<> wake;
+                    {
+                    std::lock_guard<std::mutex> g(_c->_lock);
+                    if (!_c->take(*this, wake)) {
+                        _h = h;
+                        _c->_consumers.push_back(this);
+                        return true;}
+                    }
+                    if (wake)
+                        _c->_executor.schedule(wake);
+                    return false;}
+
+                std::optional<T> await_resume () {
+                    return std::move(_value);}};
+
+        // ------------
+        // push_awaiter
+        // ------------
+
+        class push_awaiter {
+            private:
+                friend class AsyncDequeChannel;
+
+                AsyncDequeChannel*      _c;
+                T                       _value;
+                bool                    _accepted;
+                std::coroutine_handle<> _h;
+
+            public:
+                push_awaiter (AsyncDequeChannel* c, T v) :
+                        _c(c),
+                        _value(std::move(v)),
+                        _accepted(false)
+                    {}
+
+                /**
+                 * Done at once if the channel is closed or there is room and
+                 * no consumer to hand the item to.
+                 */
+                bool await_ready () {
+                    std::lock_guard<std::mutex> g(_c->_lock);
+                    if (_c->_closed)
+                        return true;
+                    if (!_c->_consumers.empty() || _c->full())
+                        return false;
+                    _c->_items.push_back(std::move(_value));
+                    _accepted = true;
+                    return true;}
+
+                /**
+                 * Hands the item to a waiting consumer and resumes it right
+                 * away, or waits for room.
+                 */
+                std::coroutine_handle<> await_suspend (std::coroutine_handle<> h) {
+                    std::unique_lock<std::mutex> g(_c->_lock);
+                    if (_c->_closed)
+                        return h;
+                    if (!_c->_consumers.empty()) {
+                        pop_awaiter* a = _c->_consumers.front();
+                        _c->_consumers.pop_front();
+                        a->_value.emplace(std::move(_value));
+                        _accepted = true;
+                        channel_executor& e = _c->_executor;
+                        const std::coroutine_handle<> next = a->_h;
+                        g.unlock();
+                        e.schedule(h);
+                        return next;}
+                    if (!_c->full()) {
+                        _c->_items.push_back(std::move(_value));
+                        _accepted = true;
+                        return h;}
+                    _h = h;
+                    _c->_producers.push_back(this);
+                    return std::noop_coroutine();}
+
+                /**
+                 * @return false if the channel was closed before the item went in
+                 */
+                bool await_resume () {
+                    return _accepted;}};
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        /**
+         * @param e is the executor that waiters are resumed on
+         * @param capacity is the most items held, 0 for unbounded -- defaulted
+         */
+        explicit AsyncDequeChannel (channel_executor& e, size_type capacity = 0) :
+                _capacity(capacity),
+                _closed(false),
+                _executor(e)
+            {}
+
+        AsyncDequeChannel (const AsyncDequeChannel&) = delete;
+        AsyncDequeChannel& operator = (const AsyncDequeChannel&) = delete;
+
+        // -----
+        // close
+        // -----
+
+        /**
+         * Refuses further pushes, and wakes every waiter: consumers get an
+         * empty optional, producers false. Items already in stay poppable.
+         */
+        void close () {
+            std::vector< std::coroutine_handle<> > wake;
+            {
+            std::lock_guard<std::mutex> g(_lock);
+            _closed = true;
+            for (; !_consumers.empty(); _consumers.pop_front())
+                wake.push_back(_consumers.front()->_h);
+            for (; !_producers.empty(); _producers.pop_front())
+                wake.push_back(_producers.front()->_h);
+            }
+            _executor.schedule_batch(wake.data(), wake.size());}
+
+        bool closed () {
+            std::lock_guard<std::mutex> g(_lock);
+            return _closed;}
+
+        // ---
+        // pop
+        // ---
+
+        /**
+         * @return an awaitable yielding optional<T>, empty once closed and drained
+         */
+        pop_awaiter pop () {
+            return pop_awaiter(this);}
+
+        /**
+         * @return the front item if there is one, without waiting
+         */
+        std::optional<T> try_pop () {
+            pop_awaiter a(this);
+            a.await_ready();
+            return std::move(a._value);}
+
+        // ----
+        // push
+        // ----
+
+        /**
+         * @return an awaitable yielding false if the channel was closed
+         */
+        push_awaiter push (T v) {
+            return push_awaiter(this, std::move(v));}
+
+        /**
+         * Pushes from [b, e) until the channel is full, without waiting,
+         * handing items to waiting consumers first and waking all of them
+         * with one schedule_batch().
+         * @return the first item not pushed
+         */
+        template <typename I>
+        I push_range (I b, I e) {
+            std::vector< std::coroutine_handle<> > wake;
+            {
+            std::lock_guard<std::mutex> g(_lock);
+            for (; b != e && !_closed && !_consumers.empty(); ++b) {
+                pop_awaiter* a = _consumers.front();
+                _consumers.pop_front();
+                a->_value.emplace(*b);
+                wake.push_back(a->_h);}
+            for (; b != e && !_closed && !full(); ++b)
+                _items.push_back(*b);
+            }
+            _executor.schedule_batch(wake.data(), wake.size());
+            return b;}
+
+        // ----
+        // size
+        // ----
+
+        /**
+         * @return the number of items waiting to be popped
+         */
+        size_type size () {
+            std::lock_guard<std::mutex> g(_lock);
+            return _items.size();}};
+
+#endif // AsyncDequeChannel_h
@@ -0,0 +1,932 @@
+// -----------------------------
+// projects/deque/BenchDeque.c++
+// -----------------------------
+
+/*
+To run the benchmarks:
+    % make BenchDeque
+    % ./BenchDeque               # every benchmark
+    % ./BenchDeque window sorted # the ones named on the command line
+*/
+
+// --------
+// includes
+// --------
+
+#include <algorithm>  // copy, lower_bound, max, max_element, min_element, nth_element, shuffle, sort, stable_sort, upper_bound
+#include <atomic>     // atomic
+#include <chrono>     // steady_clock
+#include <cstdio>     // fgets, fopen, printf, snprintf, sscanf
+#include <cstring>    // memcpy, memset, strcmp
+#include <deque>      // deque
+#include <functional> // greater
+#include <memory>     // allocator
+#include <mutex>      // lock_guard, mutex
+#include <numeric>    // accumulate
+#include <optional>   // optional
+#include <random>     // mt19937
+#include <thread>     // this_thread, thread
+#include <vector>     // vector
+
+#include <linux/perf_event.h> // perf_event_attr, PERF_*
+#include <sys/ioctl.h>         // ioctl
+#include <sys/syscall.h>       // __NR_perf_event_open
+#include <sys/wait.h>          // waitpid
+#include <unistd.h>            // close, fork, pipe, read, syscall, write, _exit
+
+#include "AsyncDequeChannel.h"
+#include "BlockAllocator.h"
+#include "CompressedDeque.h"
+#include "Deque.h"
+#include "DequeSort.h"
+#include "ShardedDeque.h"
+#include "SharedDeque.h"
+#include "SlidingWindow.h"
+#include "SoADeque.h"
+#include "SortedDeque.h"
+#include "TieredDeque.h"
+
+// ------
+// timing
+// ------
+
+typedef std::chrono::steady_clock bench_clock;
+
+/**
+ * @return nanoseconds from t to now divided by n
+ */
+double ns_per (bench_clock::time_point t, double n) {
+    return std::chrono::duration<double, std::nano>(bench_clock::now() - t).count() / n;}
+
+/**
+ * Keeps the optimizer from discarding a result.
+ */
+volatile long bench_sink;
+
+// ------
+// window
+// ------
+
+/**
+ * Time-windowed metrics: per step one sample arrives, the oldest expires and
+ * the sum, min and max of the window are read, either from SlidingWindow and
+ * MonotonicWindow or by rescanning a MyDeque.
+ */
+void bench_window () {
+    std::printf("%-10s %14s %14s\n", "window", "adapters ns", "rescan ns");
+    for (long w = 1000; w <= 10000000; w *= 10) {
+        SlidingWindow<long>                         sum;
+        MonotonicWindow<long>                       lo;
+        MonotonicWindow<long, std::greater<long> >  hi;
+        MyDeque<long>                               raw;
+        unsigned r = 1;
+        for (long i = 0; i < w; ++i) {
+            r = r * 1103515245 + 12345;
+            const long v = r >> 8;
+            sum.push_back(v, i);
+            lo.push_back(v, i);
+            hi.push_back(v, i);
+            raw.push_back(v);}
+
+        const long steps = 1000000;
+        bench_clock::time_point t = bench_clock::now();
+        for (long i = 0; i < steps; ++i) {
+            r = r * 1103515245 + 12345;
+            const long v = r >> 8;
+            sum.push_back(v, w + i);
+            lo.push_back(v, w + i);
+            hi.push_back(v, w + i);
+            sum.expire_before(i + 1);
+            lo.expire_before(i + 1);
+            hi.expire_before(i + 1);
+            bench_sink = sum.aggregate() + lo.extreme() + hi.extreme();}
+        const double adapters = ns_per(t, steps);
+
+        const long scans = std::max(10L, 200000000L / w);
+        t = bench_clock::now();
+        for (long i = 0; i < scans; ++i) {
+            r = r * 1103515245 + 12345;
+            raw.push_back(r >> 8);
+            raw.pop_front();
+            bench_sink = std::accumulate(raw.begin(), raw.end(), 0L) + *std::min_element(raw.begin(), raw.end()) + *std::max_element(raw.begin(), raw.end());}
+        const double rescan = ns_per(t, scans);
+
+        std::printf("%-10ld %14.1f %14.1f\n", w, adapters, rescan);}}
+
+// ------
+// sorted
+// ------
+
+/**
+ * Ordered inserts of random keys and lower_bound lookups, into a SortedDeque
+ * and into a MyDeque kept sorted with std::upper_bound and insert().
+ */
+void bench_sorted () {
+    std::printf("%-10s %14s %14s %14s %14s\n", "size", "insert ns", "MyDeque ns", "search ns", "MyDeque ns");
+    for (long n = 1000; n <= 1000000; n *= 10) {
+        SortedDeque<long> x;
+        MyDeque<long>     y;
+        unsigned r = 1;
+        bench_clock::time_point t = bench_clock::now();
+        for (long i = 0; i < n; ++i) {
+            r = r * 1103515245 + 12345;
+            x.insert_sorted(r >> 4);}
+        const double sorted_insert = ns_per(t, n);
+
+        const long m = std::min(n, 50000L);
+        r = 1;
+        t = bench_clock::now();
+        for (long i = 0; i < m; ++i) {
+            r = r * 1103515245 + 12345;
+            const long v = r >> 4;
+            y.insert(std::upper_bound(y.begin(), y.end(), v), v);}
+        const double deque_insert = ns_per(t, m);
+        for (long i = m; i < n; ++i) {
+            r = r * 1103515245 + 12345;
+            y.push_back(r >> 4);}
+        std::sort(y.begin(), y.end());
+
+        const long lookups = 1000000;
+        long sum = 0;
+        t = bench_clock::now();
+        for (long i = 0; i < lookups; ++i) {
+            r = r * 1103515245 + 12345;
+            SortedDeque<long>::const_iterator p = x.lower_bound(r >> 4);
+            sum += (p == x.end()) ? 0 : *p;}
+        const double sorted_search = ns_per(t, lookups);
+        t = bench_clock::now();
+        for (long i = 0; i < lookups; ++i) {
+            r = r * 1103515245 + 12345;
+            MyDeque<long>::iterator p = std::lower_bound(y.begin(), y.end(), long(r >> 4));
+            sum += (p == y.end()) ? 0 : *p;}
+        const double deque_search = ns_per(t, lookups);
+        bench_sink = sum;
+
+        std::printf("%-10ld %14.1f %14.1f %14.1f %14.1f\n", n, sorted_insert, deque_insert, sorted_search, deque_search);}}
+
+// --------
+// prefetch
+// --------
+
+/**
+ * Row-sized chunks of one arena in shuffled order, as a heap that has been
+ * running for a while would hand them out.
+ */
+struct scattered_arena {
+    static const std::size_t CHUNK = 64;
+    static char*              base;
+    static std::size_t        size;
+    static std::vector<char*> chunks;
+
+    static void reset (std::size_t n) {
+        delete [] base;
+        size = n * CHUNK;
+        base = new char[size];
+        chunks.clear();
+        for (std::size_t i = 0; i != n; ++i)
+            chunks.push_back(base + i * CHUNK);
+        std::shuffle(chunks.begin(), chunks.end(), std::mt19937(1));}};
+
+char*              scattered_arena::base = 0;
+std::size_t        scattered_arena::size = 0;
+std::vector<char*> scattered_arena::chunks;
+
+/**
+ * Takes allocations of up to a chunk from scattered_arena and anything
+ * larger from std::allocator.
+ */
+template <typename T>
+struct scattered_allocator : std::allocator<T> {
+    template <typename U>
+    struct rebind {
+        typedef scattered_allocator<U> other;};
+
+    scattered_allocator () {}
+
+    template <typename U>
+    scattered_allocator (const scattered_allocator<U>&) {}
+
+    T* allocate (std::size_t n) {
+        if (n * sizeof(T) > scattered_arena::CHUNK || scattered_arena::chunks.empty())
+            return std::allocator<T>::allocate(n);
+        char* p = scattered_arena::chunks.back();
+        scattered_arena::chunks.pop_back();
+        return reinterpret_cast<T*>(p);}
+
+    void deallocate (T* p, std::size_t n) {
+        char* c = reinterpret_cast<char*>(p);
+        if (c >= scattered_arena::base && c < scattered_arena::base + scattered_arena::size)
+            scattered_arena::chunks.push_back(c);
+        else
+            std::allocator<T>::deallocate(p, n);}};
+
+/**
+ * Sums a deque much larger than the last level cache whose rows sit at
+ * shuffled addresses: by iterator, and by for_each_segment() at several
+ * prefetch distances.
+ */
+void bench_prefetch () {
+    typedef MyDeque<long, scattered_allocator<long> > deque_type;
+    const long n = 32L << 20;
+    scattered_arena::reset(n / deque_type::INNER_SIZE + 1);
+    deque_type x;
+    for (long i = 0; i < n; ++i)
+        x.push_back(i);
+    const double mb = n * sizeof(long) / 1e6;
+    std::printf("%-22s %10s\n", "scan of 256 MB", "MB/s");
+
+    for (int pass = 0; pass < 2; ++pass) {
+        bench_clock::time_point t = bench_clock::now();
+        long sum = 0;
+        for (deque_type::const_iterator b = x.begin(), e = x.end(); b != e; ++b)
+            sum += *b;
+        bench_sink = sum;
+        if (pass)
+            std::printf("%-22s %10.0f\n", "iterator", mb * 1e3 / ns_per(t, 1e6));
+
+        const std::size_t distances[] = {0, 2, 8, 16, 32, 64};
+        for (std::size_t d : distances) {
+            t = bench_clock::now();
+            sum = 0;
+            x.for_each_segment([&sum] (const long* p, std::size_t k) {
+                for (std::size_t i = 0; i != k; ++i)
+                    sum += p[i];}, d);
+            bench_sink = sum;
+            if (pass)
+                std::printf("for_each_segment(%-3zu) %10.0f\n", d, mb * 1e3 / ns_per(t, 1e6));}}}
+
+// -----
+// pages
+// -----
+
+/**
+ * Counts this process's user-space data TLB load misses through
+ * perf_event_open(), where the kernel and the CPU allow it.
+ */
+class tlb_counter {
+    private:
+        int _fd;
+
+    public:
+        tlb_counter () {
+            perf_event_attr a;
+            std::memset(&a, 0, sizeof(a));
+            a.size           = sizeof(a);
+            a.type           = PERF_TYPE_HW_CACHE;
+            a.config         = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            a.disabled       = 1;
+            a.exclude_kernel = 1;
+            a.exclude_hv     = 1;
+            _fd = ::syscall(__NR_perf_event_open, &a, 0, -1, -1, 0);}
+
+        ~tlb_counter () {
+            if (_fd >= 0)
+                ::close(_fd);}
+
+        void start () {
+            if (_fd >= 0) {
+                ::ioctl(_fd, PERF_EVENT_IOC_RESET, 0);
+                ::ioctl(_fd, PERF_EVENT_IOC_ENABLE, 0);}}
+
+        /**
+         * @return the misses since start(), or -1 if they can't be counted
+         */
+        long stop () {
+            long long n = -1;
+            if (_fd < 0)
+                return -1;
+            ::ioctl(_fd, PERF_EVENT_IOC_DISABLE, 0);
+            if (::read(_fd, &n, sizeof(n)) != sizeof(n))
+                return -1;
+            return n;}};
+
+/**
+ * @return the AnonHugePages of this process in MB, or -1 if unknown
+ */
+long anon_huge_mb () {
+    std::FILE* f = std::fopen("/proc/self/smaps_rollup", "r");
+    if (!f)
+        return -1;
+    char line[256];
+    long kb = -1;
+    while (std::fgets(line, sizeof(line), f))
+        if (std::sscanf(line, "AnonHugePages: %ld kB", &kb) == 1)
+            break;
+    std::fclose(f);
+    return kb < 0 ? -1 : kb / 1024;}
+
+/**
+ * Builds a 1 GB MyDeque<long, A>, then scans it by iterator and by
+ * for_each_segment(), reporting MB/s and data TLB misses per scan.
+ */
+template <typename A>
+void bench_pages_with (const char* name) {
+    typedef MyDeque<long, A> deque_type;
+    const long n = 128L << 20;
+    const double mb = n * sizeof(long) / 1e6;
+    tlb_counter tlb;
+    bench_clock::time_point t = bench_clock::now();
+    deque_type x;
+    for (long i = 0; i < n; ++i)
+        x.push_back(i);
+    const double build = ns_per(t, n);
+    const long huge = anon_huge_mb();
+
+    long sum = 0;
+    tlb.start();
+    t = bench_clock::now();
+    for (typename deque_type::const_iterator b = x.begin(), e = x.end(); b != e; ++b)
+        sum += *b;
+    const double it_mbs = mb * 1e3 / ns_per(t, 1e6);
+    const long it_tlb = tlb.stop();
+
+    tlb.start();
+    t = bench_clock::now();
+    x.for_each_segment([&sum] (const long* p, std::size_t k) {
+        for (std::size_t i = 0; i != k; ++i)
+            sum += p[i];});
+    const double seg_mbs = mb * 1e3 / ns_per(t, 1e6);
+    const long seg_tlb = tlb.stop();
+    bench_sink = sum;
+
+    char it_miss[32] = "n/a";
+    char seg_miss[32] = "n/a";
+    if (it_tlb >= 0)
+        std::snprintf(it_miss, sizeof(it_miss), "%ld", it_tlb);
+    if (seg_tlb >= 0)
+        std::snprintf(seg_miss, sizeof(seg_miss), "%ld", seg_tlb);
+    std::printf("%-12s %4zu %9.1f %9ld %10.0f %12s %10.0f %12s\n", name, std::size_t(deque_type::INNER_SIZE), build, huge, it_mbs, it_miss, seg_mbs, seg_miss);}
+
+/**
+ * 1 GB scans with the default rows, cache-line rows and huge page rows.
+ */
+void bench_pages () {
+    std::printf("%-12s %4s %9s %9s %10s %12s %10s %12s\n", "allocator", "row", "build ns", "THP MB", "iter MB/s", "iter dTLB", "seg MB/s", "seg dTLB");
+    bench_pages_with< std::allocator<long> >("std");
+    bench_pages_with< AlignedAllocator<long> >("aligned");
+    bench_pages_with< HugePageAllocator<long> >("huge page");}
+
+// -------
+// channel
+// -------
+
+channel_task bench_ping (AsyncDequeChannel<long>* to, AsyncDequeChannel<long>* from, long n, std::atomic<int>* done) {
+    for (long i = 0; i < n; ++i) {
+        co_await to->push(i);
+        co_await from->pop();}
+    to->close();
+    ++*done;}
+
+channel_task bench_pong (AsyncDequeChannel<long>* from, AsyncDequeChannel<long>* to, std::atomic<int>* done) {
+    for (;;) {
+        std::optional<long> v = co_await from->pop();
+        if (!v)
+            break;
+        co_await to->push(*v);}
+    ++*done;}
+
+/**
+ * Round trips between two tasks over a pair of channels, against two
+ * threads that poll a pair of mutex-guarded MyDeques.
+ */
+void bench_channel () {
+    const long n = 200000;
+    std::printf("%-28s %12s\n", "ping-pong", "round trip ns");
+    {
+    single_thread_executor e;
+    AsyncDequeChannel<long> a(e);
+    AsyncDequeChannel<long> b(e);
+    std::atomic<int> done(0);
+    bench_clock::time_point t = bench_clock::now();
+    spawn(e, bench_pong(&a, &b, &done));
+    spawn(e, bench_ping(&a, &b, n, &done));
+    e.run();
+    std::printf("%-28s %12.1f\n", "channel, 1 thread", ns_per(t, n));
+    }
+    {
+    std::atomic<int> done(0);
+    bench_clock::time_point t;
+    {
+    thread_pool_executor e(2);
+    AsyncDequeChannel<long> a(e);
+    AsyncDequeChannel<long> b(e);
+    t = bench_clock::now();
+    spawn(e, bench_pong(&a, &b, &done));
+    spawn(e, bench_ping(&a, &b, n, &done));
+    while (done != 2)
+        std::this_thread::yield();
+    }
+    std::printf("%-28s %12.1f\n", "channel, 2 thread pool", ns_per(t, n));
+    }
+    {
+    // Fewer rounds: with fewer cores than threads a poller can hold the
+    // core for a whole time slice per round trip.
+    const long m = std::max(100L, n * long(std::thread::hardware_concurrency() > 1) / 10);
+    std::mutex lock;
+    MyDeque<long> a;
+    MyDeque<long> b;
+    bench_clock::time_point t = bench_clock::now();
+    std::thread pong([&] () {
+        for (long i = 0; i < m; ++i) {
+            long v;
+            for (;;) {
+                std::lock_guard<std::mutex> g(lock);
+                if (!a.empty()) {
+                    v = a.front();
+                    a.pop_front();
+                    break;}}
+            std::lock_guard<std::mutex> g(lock);
+            b.push_back(v);}});
+    for (long i = 0; i < m; ++i) {
+        {
+        std::lock_guard<std::mutex> g(lock);
+        a.push_back(i);
+        }
+        for (;;) {
+            std::lock_guard<std::mutex> g(lock);
+            if (!b.empty()) {
+                b.pop_front();
+                break;}}}
+    pong.join();
+    std::printf("%-28s %12.1f\n", "polled MyDeque, 2 threads", ns_per(t, m));
+    }}
+
+// -----
+// batch
+// -----
+
+/**
+ * Fills a MyDeque<long, A> and drains it again in chunks, one element at a
+ * time with push_back and front() plus pop_front(), and a chunk at a time
+ * with push_back_n and pop_front_n; memcpy of the same chunks is the floor.
+ */
+template <typename A>
+void bench_batch_with (const char* name) {
+    const long n = 1 << 24;
+    for (long c = 16; c <= 65536; c *= 64) {
+        std::vector<long> in(c);
+        std::vector<long> out(c);
+        for (long i = 0; i < c; ++i)
+            in[i] = i;
+        MyDeque<long, A> x;
+
+        bench_clock::time_point t = bench_clock::now();
+        for (long i = 0; i < n; i += c)
+            for (long j = 0; j < c; ++j)
+                x.push_back(in[j]);
+        const double push = ns_per(t, n);
+        t = bench_clock::now();
+        for (long i = 0; i < n; i += c) {
+            for (long j = 0; j < c; ++j) {
+                out[j] = x.front();
+                x.pop_front();}
+            bench_sink = out[c - 1];}
+        const double pop = ns_per(t, n);
+
+        t = bench_clock::now();
+        for (long i = 0; i < n; i += c)
+            x.push_back_n(in.data(), c);
+        const double push_n = ns_per(t, n);
+        t = bench_clock::now();
+        for (long i = 0; i < n; i += c) {
+            x.pop_front_n(out.data(), c);
+            bench_sink = out[c - 1];}
+        const double pop_n = ns_per(t, n);
+
+        std::vector<long> flat(n, 1);
+        t = bench_clock::now();
+        for (long i = 0; i < n; i += c)
+            std::memcpy(flat.data() + i, in.data(), c * sizeof(long));
+        for (long i = 0; i < n; i += c) {
+            std::memcpy(out.data(), flat.data() + i, c * sizeof(long));
+            bench_sink = out[c - 1];}
+        const double copy = ns_per(t, 2 * n);
+
+        std::printf("%-10s %8ld %12.2f %12.2f %12.2f %12.2f %12.2f\n", name, c, push, push_n, pop, pop_n, copy);}}
+
+void bench_batch () {
+    std::printf("%-10s %8s %12s %12s %12s %12s %12s\n", "rows", "chunk", "push ns", "push_n ns", "pop ns", "pop_n ns", "memcpy ns");
+    bench_batch_with< std::allocator<long> >("default");
+    bench_batch_with< AlignedAllocator<long> >("aligned");}
+
+// -------
+// latency
+// -------
+
+/**
+ * Times each of n push_backs onto a MyDeque<long, std::allocator<long>, 0, G>
+ * and prints the percentiles of the per-push latency.
+ */
+template <typename G>
+void bench_latency_with (const char* name, long n) {
+    std::vector<float> ns(n);
+    MyDeque<long, std::allocator<long>, 0, G> x;
+    for (long i = 0; i < n; ++i) {
+        const bench_clock::time_point t = bench_clock::now();
+        x.push_back(i);
+        ns[i] = std::chrono::duration<float, std::nano>(bench_clock::now() - t).count();}
+    bench_sink = x.back();
+    const long p[] = {500, 990, 999};
+    std::printf("%-12s %10ld", name, n);
+    for (long q : p) {
+        std::nth_element(ns.begin(), ns.begin() + n / 1000 * q, ns.end());
+        std::printf(" %10.0f", ns[n / 1000 * q]);}
+    std::printf(" %12.0f\n", *std::max_element(ns.begin(), ns.end()));}
+
+/**
+ * Per-push latency with the map growing at once and incrementally; the
+ * difference is in the tail, where a doubling push copies every row pointer.
+ */
+void bench_latency () {
+    std::printf("%-12s %10s %10s %10s %10s %12s\n", "growth", "pushes", "p50 ns", "p99 ns", "p99.9 ns", "max ns");
+    for (long n = 1000000; n <= 64000000; n *= 8) {
+        bench_latency_with<deque_doubling_growth>("doubling", n);
+        bench_latency_with<deque_incremental_growth>("incremental", n);}}
+
+// -------
+// sharded
+// -------
+
+/**
+ * Runs f(i) on threads 0, ..., t - 1 at once.
+ * @return wall nanoseconds per op, for ops in all
+ */
+template <typename F>
+double bench_threads (int t, long ops, F f) {
+    std::atomic<int> ready(0);
+    std::vector<std::thread> threads;
+    bench_clock::time_point start;
+    for (int i = 0; i < t; ++i)
+        threads.push_back(std::thread([&, i] () {
+            if (++ready == t)
+                start = bench_clock::now();
+            while (ready.load() != t)
+                std::this_thread::yield();
+            f(i);}));
+    for (std::thread& h : threads)
+        h.join();
+    return ns_per(start, ops);}
+
+/**
+ * Threads that each push and pop in turn: one MyDeque behind a mutex, a
+ * ShardedDeque with a shard per thread, and a ShardedDeque with a shard per
+ * CPU that threads reach through local_shard(). Throughput only scales with
+ * more CPUs than this machine may have.
+ */
+void bench_sharded () {
+    std::printf("%-10s %14s %14s %14s\n", "threads", "mutex ns/op", "shard ns/op", "per-cpu ns/op");
+    const long n = 1000000;
+    for (int t = 1; t <= 8; t *= 2) {
+        std::mutex lock;
+        MyDeque<long> one;
+        const double locked = bench_threads(t, 2 * n, [&] (int) {
+            for (long j = 0; j < n / t; ++j) {
+                {
+                std::lock_guard<std::mutex> g(lock);
+                one.push_back(j);
+                }
+                std::lock_guard<std::mutex> g(lock);
+                if (!one.empty()) {
+                    bench_sink = one.front();
+                    one.pop_front();}}});
+
+        ShardedDeque<long> x(t);
+        const double sharded = bench_threads(t, 2 * n, [&] (int i) {
+            long v;
+            for (long j = 0; j < n / t; ++j) {
+                x.push_back(j, i);
+                if (x.try_pop(v, i))
+                    bench_sink = v;}});
+
+        ShardedDeque<long> y;
+        const double local = bench_threads(t, 2 * n, [&] (int) {
+            long v;
+            for (long j = 0; j < n / t; ++j) {
+                y.push_back(j);
+                if (y.try_pop(v))
+                    bench_sink = v;}});
+
+        std::printf("%-10d %14.1f %14.1f %14.1f\n", t, locked, sharded, local);}}
+
+// ----
+// sort
+// ----
+
+/**
+ * Sorts n random ints held in a MyDeque<int, A> each way: deque_sort,
+ * deque_stable_sort, deque_radix_sort, std::stable_sort over the deque's
+ * iterators, and copying out to a vector, sorting that and copying back.
+ */
+template <typename A>
+void bench_sort_with (const char* name, long n) {
+    std::mt19937 g(1);
+    MyDeque<int, A> x;
+    for (long i = 0; i < n; ++i)
+        x.push_back(static_cast<int>(g()));
+    MyDeque<int, A> y;
+    double ns[5];
+    for (int k = 0; k != 5; ++k) {
+        y = x;
+        const bench_clock::time_point t = bench_clock::now();
+        if (k == 0)
+            deque_sort(y);
+        else if (k == 1)
+            deque_stable_sort(y);
+        else if (k == 2)
+            deque_radix_sort(y);
+        else if (k == 3)
+            std::stable_sort(y.begin(), y.end());
+        else {
+            std::vector<int> v(y.begin(), y.end());
+            std::sort(v.begin(), v.end());
+            std::copy(v.begin(), v.end(), y.begin());}
+        ns[k] = ns_per(t, n);
+        bench_sink = y.back();}
+    std::printf("%-10s %10ld %10.1f %10.1f %10.1f %12.1f %10.1f\n", name, n, ns[0], ns[1], ns[2], ns[3], ns[4]);}
+
+void bench_sort () {
+    std::printf("%-10s %10s %10s %10s %10s %12s %10s\n", "rows", "elements", "sort ns", "stable ns", "radix ns", "std::stable", "vector ns");
+    for (long n = 100000; n <= 10000000; n *= 10) {
+        bench_sort_with< std::allocator<int> >("default", n);
+        bench_sort_with< AlignedAllocator<int> >("aligned", n);}}
+
+// ----------
+// compressed
+// ----------
+
+/**
+ * n timestamps with a stride of about 1000 and some jitter, pushed onto a
+ * CompressedDeque and onto MyDeques with default and aligned rows: bytes per
+ * element, ns per push_back and ns per element of a for_each_segment() sum.
+ * MyDeque's bytes count its rows only.
+ */
+void bench_compressed () {
+    std::printf("%-12s %10s %10s %10s %10s\n", "deque", "elements", "bytes/elt", "push ns", "scan ns");
+    for (long n = 1000000; n <= 16000000; n *= 4) {
+        std::uint64_t sum = 0;
+        CompressedDeque<> x;
+        bench_clock::time_point t = bench_clock::now();
+        std::uint64_t v = 1;
+        for (long i = 0; i < n; ++i)
+            x.push_back(v += 1000 + (i * 7919) % 200);
+        double push = ns_per(t, n);
+        t = bench_clock::now();
+        x.for_each_segment([&] (const std::uint64_t* p, std::size_t k) {
+            for (std::size_t i = 0; i != k; ++i)
+                sum += p[i];});
+        std::printf("%-12s %10ld %10.2f %10.1f %10.2f\n", "compressed", n, double(x.bytes()) / n, push, ns_per(t, n));
+
+        MyDeque<std::uint64_t> y;
+        t = bench_clock::now();
+        v = 1;
+        for (long i = 0; i < n; ++i)
+            y.push_back(v += 1000 + (i * 7919) % 200);
+        push = ns_per(t, n);
+        t = bench_clock::now();
+        y.for_each_segment([&] (const std::uint64_t* p, std::size_t k) {
+            for (std::size_t i = 0; i != k; ++i)
+                sum += p[i];});
+        std::printf("%-12s %10ld %10.2f %10.1f %10.2f\n", "default", n, double(sizeof(std::uint64_t)), push, ns_per(t, n));
+
+        MyDeque< std::uint64_t, AlignedAllocator<std::uint64_t> > z;
+        t = bench_clock::now();
+        v = 1;
+        for (long i = 0; i < n; ++i)
+            z.push_back(v += 1000 + (i * 7919) % 200);
+        push = ns_per(t, n);
+        t = bench_clock::now();
+        z.for_each_segment([&] (const std::uint64_t* p, std::size_t k) {
+            for (std::size_t i = 0; i != k; ++i)
+                sum += p[i];});
+        std::printf("%-12s %10ld %10.2f %10.1f %10.2f\n", "aligned", n, double(sizeof(std::uint64_t)), push, ns_per(t, n));
+        bench_sink = static_cast<long>(sum);}}
+
+// ------
+// tiered
+// ------
+
+/**
+ * Fills a C with n longs, then times inserts and erases at random positions
+ * and reads at random indices: ops of each, fewer for the O(n) deques.
+ */
+template <typename C>
+void bench_tiered_with (const char* name, long n, long ops) {
+    std::mt19937 g(1);
+    C x;
+    for (long i = 0; i < n; ++i)
+        x.push_back(i);
+    bench_clock::time_point t = bench_clock::now();
+    for (long i = 0; i < ops; ++i)
+        x.insert(x.begin() + g() % x.size(), i);
+    const double insert = ns_per(t, ops);
+    t = bench_clock::now();
+    for (long i = 0; i < ops; ++i)
+        x.erase(x.begin() + g() % x.size());
+    const double erase = ns_per(t, ops);
+    long sum = 0;
+    t = bench_clock::now();
+    for (long i = 0; i < 1000000; ++i)
+        sum += x[g() % x.size()];
+    const double read = ns_per(t, 1000000);
+    bench_sink = sum;
+    std::printf("%-12s %10ld %14.0f %14.0f %10.1f\n", name, n, insert, erase, read);}
+
+/**
+ * Middle inserts and erases, which MyDeque and std::deque do in O(n) and
+ * TieredDeque in O(sqrt(n)), with the O(1) random reads all three keep.
+ */
+void bench_tiered () {
+    std::printf("%-12s %10s %14s %14s %10s\n", "deque", "elements", "insert ns", "erase ns", "read ns");
+    for (long n = 1000000; n <= 100000000; n *= 10) {
+        bench_tiered_with< TieredDeque<long> >("tiered", n, 100000);
+        bench_tiered_with< MyDeque<long> >("MyDeque", n, std::max(2L, 200000000L / n));
+        bench_tiered_with< std::deque<long> >("std::deque", n, std::max(2L, 200000000L / n));}}
+
+// ------
+// shared
+// ------
+
+struct bench_record {
+    std::uint64_t ts;
+    double        price;
+    std::uint32_t qty;
+    std::uint32_t flags;};
+
+/**
+ * A child process produces n records for its parent: through a pipe, each
+ * record serialized field by field into 64 KiB writes and parsed back out;
+ * then through a SharedDeque, one push_back per record and then
+ * push_back_n per 1024, drained with consume() in both cases.
+ */
+void bench_shared () {
+    std::printf("%-24s %10s %12s\n", "transport", "records", "ns/record");
+    const long n = 10000000;
+    const std::size_t B = 1 << 16;
+    {
+    int fd[2];
+    if (::pipe(fd))
+        return;
+    const bench_clock::time_point t = bench_clock::now();
+    if (!::fork()) {
+        ::close(fd[0]);
+        std::vector<char> buf(B);
+        std::size_t used = 0;
+        for (long i = 0; i < n; ++i) {
+            const bench_record r = {std::uint64_t(i), i * 0.25, std::uint32_t(i), 0};
+            char* p = buf.data() + used;
+            std::memcpy(p, &r.ts, 8);
+            std::memcpy(p + 8, &r.price, 8);
+            std::memcpy(p + 16, &r.qty, 4);
+            std::memcpy(p + 20, &r.flags, 4);
+            used += 24;
+            if (used + 24 > B || i + 1 == n) {
+                for (std::size_t w = 0; w != used; ) {
+                    const ssize_t k = ::write(fd[1], buf.data() + w, used - w);
+                    if (k <= 0)
+                        ::_exit(1);
+                    w += k;}
+                used = 0;}}
+        ::_exit(0);}
+    ::close(fd[1]);
+    std::vector<char> buf(B);
+    std::size_t have = 0;
+    long got = 0;
+    std::uint64_t sum = 0;
+    for (;;) {
+        const ssize_t k = ::read(fd[0], buf.data() + have, B - have);
+        if (k <= 0)
+            break;
+        have += k;
+        std::size_t j = 0;
+        for (; j + 24 <= have; j += 24, ++got) {
+            bench_record r;
+            std::memcpy(&r.ts, buf.data() + j, 8);
+            std::memcpy(&r.price, buf.data() + j + 8, 8);
+            std::memcpy(&r.qty, buf.data() + j + 16, 4);
+            std::memcpy(&r.flags, buf.data() + j + 20, 4);
+            sum += r.ts;}
+        std::memmove(buf.data(), buf.data() + j, have - j);
+        have -= j;}
+    ::close(fd[0]);
+    ::wait(0);
+    bench_sink = static_cast<long>(sum);
+    std::printf("%-24s %10ld %12.1f\n", "pipe", got, ns_per(t, n));
+    }
+    for (int batch = 0; batch != 2; ++batch) {
+        const std::string name = "/BenchDeque-" + std::to_string(::getpid());
+        SharedDeque<bench_record>::unlink(name);
+        SharedDeque<bench_record> x(name, 1 << 16);
+        const bench_clock::time_point t = bench_clock::now();
+        if (!::fork()) {
+            SharedDeque<bench_record> y(name);
+            std::vector<bench_record> b(1024);
+            for (long i = 0; i < n; ) {
+                if (batch) {
+                    const long k = std::min(1024L, n - i);
+                    for (long j = 0; j != k; ++j) {
+                        const bench_record r = {std::uint64_t(i + j), (i + j) * 0.25, std::uint32_t(i + j), 0};
+                        b[j] = r;}
+                    y.push_back_n(b.data(), k);
+                    i += k;}
+                else {
+                    const bench_record r = {std::uint64_t(i), i * 0.25, std::uint32_t(i), 0};
+                    y.push_back(r);
+                    ++i;}}
+            y.close();
+            ::_exit(0);}
+        long got = 0;
+        std::uint64_t sum = 0;
+        while (std::size_t k = x.consume([&] (const bench_record* p, std::size_t m) {
+                    for (std::size_t j = 0; j != m; ++j)
+                        sum += p[j].ts;}))
+            got += k;
+        ::wait(0);
+        SharedDeque<bench_record>::unlink(name);
+        bench_sink = static_cast<long>(sum);
+        std::printf("%-24s %10ld %12.1f\n", batch ? "SharedDeque push_back_n" : "SharedDeque push_back", got, ns_per(t, n));}}
+
+// ---
+// soa
+// ---
+
+/**
+ * n records stored whole in a MyDeque and field by field in a SoADeque,
+ * then scanned: the sum of qty, and the count of prices over a limit. A
+ * record is 24 bytes; the SoADeque scans read 4 and 8 of them.
+ */
+void bench_soa () {
+    typedef SoADeque<std::uint64_t, double, std::uint32_t, std::uint32_t> soa;
+    std::printf("%-12s %10s %12s %12s\n", "layout", "records", "qty ns", "price ns");
+    const long n = 20000000;
+    MyDeque<bench_record> x;
+    soa y;
+    for (long i = 0; i < n; ++i) {
+        const bench_record r = {std::uint64_t(i), (i % 1000) * 0.25, std::uint32_t(i % 100), 0};
+        x.push_back(r);
+        y.push_back(r.ts, r.price, r.qty, r.flags);}
+    for (int layout = 0; layout != 2; ++layout) {
+        std::uint64_t qty = 0;
+        bench_clock::time_point t = bench_clock::now();
+        if (layout)
+            y.for_each_segment<2>([&] (const std::uint32_t* p, std::size_t m) {
+                std::uint64_t s = 0;
+                for (std::size_t j = 0; j != m; ++j)
+                    s += p[j];
+                qty += s;});
+        else
+            x.for_each_segment([&] (const bench_record* p, std::size_t m) {
+                std::uint64_t s = 0;
+                for (std::size_t j = 0; j != m; ++j)
+                    s += p[j].qty;
+                qty += s;});
+        const double by_qty = ns_per(t, n);
+        std::uint64_t over = 0;
+        t = bench_clock::now();
+        if (layout)
+            y.for_each_segment<1>([&] (const double* p, std::size_t m) {
+                std::uint64_t s = 0;
+                for (std::size_t j = 0; j != m; ++j)
+                    s += (p[j] > 100.0);
+                over += s;});
+        else
+            x.for_each_segment([&] (const bench_record* p, std::size_t m) {
+                std::uint64_t s = 0;
+                for (std::size_t j = 0; j != m; ++j)
+                    s += (p[j].price > 100.0);
+                over += s;});
+        const double by_price = ns_per(t, n);
+        bench_sink = static_cast<long>(qty + over);
+        std::printf("%-12s %10ld %12.2f %12.2f\n", layout ? "SoADeque" : "MyDeque", n, by_qty, by_price);}}
+
+// ----
+// main
+// ----
+
+struct benchmark {
+    const char* name;
+    void (*run) ();};
+
+const benchmark benchmarks[] = {
+    {"window", bench_window},
+    {"sorted", bench_sorted},
+    {"prefetch", bench_prefetch},
+    {"pages", bench_pages},
+    {"channel", bench_channel},
+    {"batch", bench_batch},
+    {"latency", bench_latency},
+    {"sharded", bench_sharded},
+    {"sort", bench_sort},
+    {"compressed", bench_compressed},
+    {"tiered", bench_tiered},
+    {"shared", bench_shared},
+    {"soa", bench_soa}};
+
+int main (int argc, char** argv) {
+    for (const benchmark& b : benchmarks) {
+        bool selected = (argc == 1);
+        for (int i = 1; i < argc; ++i)
+            selected = selected || !std::strcmp(argv[i], b.name);
+        if (selected) {
+            b.run();
+            std::printf("\n");}}
+    return 0;}
@@ -0,0 +1,362 @@
+// -------------------------------
+// projects/deque/BlockAllocator.h
+// -------------------------------
+
+#ifndef BlockAllocator_h
+#define BlockAllocator_h
+
+// --------
+// includes
+// --------
+
+#include <algorithm>  // max
+#include <cstddef>    // size_t
+#include <cstdint>    // uintptr_t
+#include <cstdlib>    // free, posix_memalign
+#include <mutex>      // lock_guard, mutex
+#include <new>        // bad_alloc
+#include <vector>     // vector
+
+#include <sys/mman.h> // madvise, mmap, munmap
+
+#ifdef DEQUE_LIBNUMA
+#include <numa.h>     // numa_available, numa_tonode_memory
+#endif
+
+#include "Deque.h"
+
+// ----------------
+// AlignedAllocator
+// ----------------
+
+/**
+ * An allocator whose chunks start on an Align byte boundary and are a whole
+ * number of Align byte lines long. A MyDeque that uses it gets rows of Lines
+ * lines each (see deque_row_size below), so no row shares a cache line with
+ * another allocation and, when sizeof(T) divides Align, no element straddles
+ * two lines.
+ */
+template <typename T, std::size_t Align = 64, std::size_t Lines = 4>
+class AlignedAllocator {
+    public:
+        // --------
+        // typedefs
+        // --------
+
+        typedef T value_type;
+
+        template <typename U>
+        struct rebind {
+            typedef AlignedAllocator<U, Align, Lines> other;};
+
+        // -----------
+        // operator ==
+        // -----------
+
+        friend bool operator == (const AlignedAllocator&, const AlignedAllocator&) {
+            return true;}
+
+        friend bool operator != (const AlignedAllocator&, const AlignedAllocator&) {
+            return false;}
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        AlignedAllocator () {}
+
+        template <typename U>
+        AlignedAllocator (const AlignedAllocator<U, Align, Lines>&) {}
+
+        // --------
+        // allocate
+        // --------
+
+        /**
+         * @throws bad_alloc
+         */
+        T* allocate (std::size_t n) {
+            void* p = 0;
+            const std::size_t b = (n * sizeof(T) + Align - 1) / Align * Align;
+            if (::posix_memalign(&p, std::max(Align, sizeof(void*)), b))
+                throw std::bad_alloc();
+            return static_cast<T*>(p);}
+
+        // ----------
+        // deallocate
+        // ----------
+
+        void deallocate (T* p, std::size_t) {
+            std::free(p);}};
+
+template <typename U, std::size_t Align, std::size_t Lines>
+struct deque_row_size< AlignedAllocator<U, Align, Lines> > {
+    static const std::size_t value = (Lines * Align >= sizeof(U)) ? Lines * Align / sizeof(U) : 1;};
+
+// ---------------
+// huge_page_arena
+// ---------------
+
+/**
+ * Carves chunks out of 2 MiB regions that are aligned to 2 MiB and marked
+ * MADV_HUGEPAGE, so that the kernel can back each region with one
+ * transparent huge page and a scan over a large deque touches one TLB entry
+ * per 2 MiB instead of one per 4 KiB. Where THP is unavailable or disabled
+ * madvise() fails or is ignored and the regions are ordinary pages; nothing
+ * else changes. Chunks are a whole number of cache lines and start on one.
+ * Small chunks are recycled through one free list per size; chunks larger
+ * than a region's worth of small ones get regions of their own and are
+ * unmapped when freed. Regions for small chunks are kept until the arena is
+ * destroyed. Safe to use from several threads.
+ *
+ * An arena can be tied to a NUMA node. When built with DEQUE_LIBNUMA (and
+ * -lnuma) its regions are bound to that node before they are touched;
+ * otherwise the node is only recorded, and the pages land wherever the
+ * kernel's first-touch policy puts them.
+ */
+class huge_page_arena {
+    public:
+        //Size and alignment of a region.
+        const static std::size_t REGION = std::size_t(2) << 20;
+
+        //Every chunk starts on a cache line.
+        const static std::size_t ALIGN = 64;
+
+        //Number of small chunk sizes: ALIGN, 2 * ALIGN, ..., CLASSES * ALIGN.
+        const static std::size_t CLASSES = 1024;
+
+    private:
+        // ----
+        // data
+        // ----
+
+        std::mutex         _lock;
+        char*              _top;            // next free byte of the current region
+        char*              _end;            // end of the current region
+        void*              _free[CLASSES];  // free chunks of each small size, linked through their first word
+        std::vector<char*> _regions;        // regions for small chunks
+        std::size_t        _advised;        // bytes madvise() accepted
+        std::size_t        _mapped;         // bytes mapped
+        int                _node;           // NUMA node to bind regions to, or -1
+
+    private:
+        /**
+         * @param n is a multiple of REGION
+         * @return n bytes aligned to REGION, advised to use huge pages
+         * @throws bad_alloc
+         */
+        char* map_region (std::size_t n) {
+            void* p = ::mmap(0, n + REGION, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p == MAP_FAILED)
+                throw std::bad_alloc();
+            char* const b = static_cast<char*>(p);
+            char* const a = reinterpret_cast<char*>((reinterpret_cast<std::uintptr_t>(b) + REGION - 1) / REGION * REGION);
+            if (a != b)
+                ::munmap(b, a - b);
+            if (a + n != b + n + REGION)
+                ::munmap(a + n, (b + n + REGION) - (a + n));
+#ifdef MADV_HUGEPAGE
+            if (!::madvise(a, n, MADV_HUGEPAGE))
+                _advised += n;
+#endif
+#ifdef DEQUE_LIBNUMA
+            if (_node >= 0 && ::numa_available() >= 0)
+                ::numa_tonode_memory(a, n, _node);
+#endif
+            _mapped += n;
+            return a;}
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        /**
+         * @param node is the NUMA node for the regions, -1 for any -- defaulted
+         */
+        explicit huge_page_arena (int node = -1) :
+                _top(0),
+                _end(0),
+                _advised(0),
+                _mapped(0),
+                _node(node) {
+            for (std::size_t i = 0; i != CLASSES; ++i)
+                _free[i] = 0;}
+
+        huge_page_arena (const huge_page_arena&) = delete;
+        huge_page_arena& operator = (const huge_page_arena&) = delete;
+
+        // ----------
+        // destructor
+        // ----------
+
+        /**
+         * Unmaps the regions for small chunks; large chunks must have been freed.
+         */
+        ~huge_page_arena () {
+            for (std::size_t i = 0; i != _regions.size(); ++i)
+                ::munmap(_regions[i], REGION);}
+
+        // --------
+        // allocate
+        // --------
+
+        /**
+         * @param n is a number of bytes
+         * @return a chunk of at least n bytes, recycled if possible
+         * @throws bad_alloc
+         */
+        void* allocate (std::size_t n) {
+            const std::size_t b = (std::max<std::size_t>(n, 1) + ALIGN - 1) / ALIGN * ALIGN;
+            std::lock_guard<std::mutex> g(_lock);
+            if (b > CLASSES * ALIGN)
+                return map_region((b + REGION - 1) / REGION * REGION);
+            void*& head = _free[b / ALIGN - 1];
+            if (head) {
+                void* p = head;
+                head = *static_cast<void**>(p);
+                return p;}
+            if (_end - _top < static_cast<std::ptrdiff_t>(b)) {
+                _regions.reserve(_regions.size() + 1);
+                _top = map_region(REGION);
+                _end = _top + REGION;
+                _regions.push_back(_top);}
+            void* p = _top;
+            _top += b;
+            return p;}
+
+        // ----------
+        // deallocate
+        // ----------
+
+        /**
+         * @param p is a chunk from allocate(n)
+         * @param n is the size it was allocated with
+         */
+        void deallocate (void* p, std::size_t n) {
+            const std::size_t b = (std::max<std::size_t>(n, 1) + ALIGN - 1) / ALIGN * ALIGN;
+            std::lock_guard<std::mutex> g(_lock);
+            if (b > CLASSES * ALIGN) {
+                const std::size_t r = (b + REGION - 1) / REGION * REGION;
+                ::munmap(p, r);
+                _mapped -= r;
+                return;}
+            void*& head = _free[b / ALIGN - 1];
+            *static_cast<void**>(p) = head;
+            head = p;}
+
+        // ---------
+        // accessors
+        // ---------
+
+        /**
+         * @return the bytes mapped whose huge page advice the kernel accepted;
+         * whether it actually backs them with huge pages is up to it
+         */
+        std::size_t advised () {
+            std::lock_guard<std::mutex> g(_lock);
+            return _advised;}
+
+        /**
+         * @return the bytes currently mapped
+         */
+        std::size_t mapped () {
+            std::lock_guard<std::mutex> g(_lock);
+            return _mapped;}
+
+        /**
+         * @return the NUMA node the regions are meant for, -1 for any
+         */
+        int node () const {
+            return _node;}
+
+        /**
+         * @return the arena a default constructed HugePageAllocator uses
+         */
+        static huge_page_arena& global () {
+            static huge_page_arena a;
+            return a;}};
+
+// -----------------
+// HugePageAllocator
+// -----------------
+
+/**
+ * An allocator that hands out chunks of a huge_page_arena, the process-wide
+ * one unless it is given another. Like AlignedAllocator it gives a MyDeque
+ * rows of four cache lines.
+ */
+template <typename T>
+class HugePageAllocator {
+    public:
+        // --------
+        // typedefs
+        // --------
+
+        typedef T value_type;
+
+        template <typename U>
+        struct rebind {
+            typedef HugePageAllocator<U> other;};
+
+        // -----------
+        // operator ==
+        // -----------
+
+        friend bool operator == (const HugePageAllocator& lhs, const HugePageAllocator& rhs) {
+            return lhs._arena == rhs._arena;}
+
+        friend bool operator != (const HugePageAllocator& lhs, const HugePageAllocator& rhs) {
+            return !(lhs == rhs);}
+
+    private:
+        // ----
+        // data
+        // ----
+
+        huge_page_arena* _arena;
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        /**
+         * @param a is the arena to allocate from -- defaulted
+         */
+        explicit HugePageAllocator (huge_page_arena* a = &huge_page_arena::global()) :
+                _arena(a)
+            {}
+
+        template <typename U>
+        HugePageAllocator (const HugePageAllocator<U>& that) :
+                _arena(that.arena())
+            {}
+
+        // --------
+        // allocate
+        // --------
+
+        T* allocate (std::size_t n) {
+            return static_cast<T*>(_arena->allocate(n * sizeof(T)));}
+
+        // ----------
+        // deallocate
+        // ----------
+
+        void deallocate (T* p, std::size_t n) {
+            _arena->deallocate(p, n * sizeof(T));}
+
+        // -----
+        // arena
+        // -----
+
+        huge_page_arena* arena () const {
+            return _arena;}};
+
+template <typename U>
+struct deque_row_size< HugePageAllocator<U> > {
+    static const std::size_t value = (4 * huge_page_arena::ALIGN >= sizeof(U)) ? 4 * huge_page_arena::ALIGN / sizeof(U) : 1;};
+
+#endif // BlockAllocator_h
@@ -0,0 +1,427 @@
+// ---------------------------------
+// projects/deque/CompressedDeque.h
+// ---------------------------------
+
+#ifndef CompressedDeque_h
+#define CompressedDeque_h
+
+// --------
+// includes
+// --------
+
+#include <algorithm>   // copy, fill
+#include <cassert>     // assert
+#include <cstddef>     // size_t
+#include <cstdint>     // int64_t, uint64_t
+#include <stdexcept>   // out_of_range
+#include <type_traits> // is_integral
+
+#include "Deque.h"
+
+// ---------------
+// CompressedDeque
+// ---------------
+
+/**
+ * A deque of integers, such as timestamps or ids, that keeps all but its
+ * ends frozen in blocks of B. A frozen block stores its first value, the
+ * smallest difference between neighbours (the step) and every difference
+ * less the step, bit-packed at the width of the largest one. Values that
+ * rise by a near-constant stride need a few bits each instead of 64; values
+ * that fall or jump are still exact, just packed wider.
+ *
+ * The elements before the first frozen block and after the last are plain
+ * MyDeques of fewer than 2 * B, so pushes and pops at either end touch
+ * packed data only once every B of them: a full end freezes its inner B
+ * elements, and an empty end thaws the nearest block. Random access decodes
+ * at most one block, and for_each_segment() decodes each block once, into a
+ * buffer on the stack. Elements are returned by value, never by reference.
+ */
+template <typename T = std::uint64_t, std::size_t B = 128>
+class CompressedDeque {
+    static_assert(std::is_integral<T>::value && sizeof(T) <= 8, "CompressedDeque holds integers of at most 64 bits");
+    static_assert(B >= 2, "a frozen block needs at least two elements");
+
+    public:
+        // --------
+        // typedefs
+        // --------
+
+        typedef T           value_type;
+        typedef std::size_t size_type;
+
+        typedef MyDeque<T> end_type;
+
+        //Number of elements in a frozen block.
+        const static size_type BLOCK_SIZE = B;
+
+    private:
+        // A frozen block is one array of words: the header, then the packed
+        // differences, then a word of padding so that decoding may always
+        // read the word after the one a field starts in.
+        enum {
+            BASE   = 0,  // first value
+            STEP   = 1,  // smallest difference, as a two's complement word
+            LAST   = 2,  // last value, for back()
+            WIDTH  = 3,  // bits per packed difference, 0 to 64
+            HEADER = 4};
+
+        // ----
+        // data
+        // ----
+
+        end_type                 _head;   // before the first block
+        MyDeque<std::uint64_t*>  _blocks;
+        end_type                 _tail;   // after the last block
+
+    private:
+        // -----
+        // valid
+        // -----
+
+        bool valid () const {
+            return (_head.size() < 2 * B) && (_tail.size() < 2 * B);}
+
+        /**
+         * @return the number of words a block packed at width w takes
+         */
+        static size_type block_words (size_type w) {
+            return HEADER + ((B - 1) * w + 63) / 64 + 1;}
+
+        /**
+         * Packs the B values at v into a new block.
+         */
+        static std::uint64_t* freeze (const T* v) {
+            std::uint64_t d[B];
+            std::int64_t step = 0;
+            for (size_type i = 1; i != B; ++i) {
+                d[i] = static_cast<std::uint64_t>(v[i]) - static_cast<std::uint64_t>(v[i - 1]);
+                const std::int64_t s = static_cast<std::int64_t>(d[i]);
+                if (i == 1 || s < step)
+                    step = s;}
+            std::uint64_t range = 0;
+            for (size_type i = 1; i != B; ++i) {
+                d[i] -= static_cast<std::uint64_t>(step);
+                range |= d[i];}
+            const size_type w = range ? 64 - __builtin_clzll(range) : 0;
+            const size_type n = block_words(w);
+            std::uint64_t* b = new std::uint64_t[n];
+            std::fill(b, b + n, 0);
+            b[BASE]  = static_cast<std::uint64_t>(v[0]);
+            b[STEP]  = static_cast<std::uint64_t>(step);
+            b[LAST]  = static_cast<std::uint64_t>(v[B - 1]);
+            b[WIDTH] = w;
+            std::uint64_t* p = b + HEADER;
+            if (w)
+                for (size_type i = 1; i != B; ++i) {
+                    const size_type bit = (i - 1) * w;
+                    const size_type o   = bit % 64;
+                    p[bit / 64] |= d[i] << o;
+                    if (o + w > 64)
+                        p[bit / 64 + 1] |= d[i] >> (64 - o);}
+            return b;}
+
+        /**
+         * @return the mask of a packed difference of width w
+         */
+        static std::uint64_t width_mask (size_type w) {
+            return (w == 64) ? ~std::uint64_t(0) : (std::uint64_t(1) << w) - 1;}
+
+        /**
+         * @return the difference packed at bit of p, with width mask m
+         */
+        static std::uint64_t unpack (const std::uint64_t* p, size_type bit, std::uint64_t m) {
+            const size_type o = bit % 64;
+            // shifting by 1 and then by 63 - o is a shift by 64 - o that is 0 when o is
+            return ((p[bit / 64] >> o) | ((p[bit / 64 + 1] << 1) << (63 - o))) & m;}
+
+        /**
+         * Decodes block b into the B values at out.
+         */
+        static void thaw (const std::uint64_t* b, T* out) {
+            const size_type      w    = b[WIDTH];
+            const std::uint64_t  m    = width_mask(w);
+            const std::uint64_t* p    = b + HEADER;
+            const std::uint64_t  step = b[STEP];
+            std::uint64_t v = b[BASE];
+            out[0] = static_cast<T>(v);
+            if (w)
+                for (size_type i = 1, bit = 0; i != B; ++i, bit += w) {
+                    v += step + unpack(p, bit, m);
+                    out[i] = static_cast<T>(v);}
+            else
+                for (size_type i = 1; i != B; ++i) {
+                    v += step;
+                    out[i] = static_cast<T>(v);}}
+
+        /**
+         * @return value i of block b, decoding only differences 1 to i
+         */
+        static T thaw_one (const std::uint64_t* b, size_type i) {
+            std::uint64_t v = b[BASE] + i * b[STEP];
+            const size_type w = b[WIDTH];
+            if (w) {
+                const std::uint64_t  m = width_mask(w);
+                const std::uint64_t* p = b + HEADER;
+                for (size_type j = 0; j != i; ++j)
+                    v += unpack(p, j * w, m);}
+            return static_cast<T>(v);}
+
+        /**
+         * Moves the oldest B elements of _tail, the ones next to the blocks,
+         * into a new last block.
+         */
+        void freeze_tail () {
+            T v[B];
+            std::copy(_tail.begin(), _tail.begin() + B, v);
+            std::uint64_t* b = freeze(v);
+            try {
+                _blocks.push_back(b);}
+            catch (...) {
+                delete [] b;
+                throw;}
+            _tail.erase_front(B);}
+
+        /**
+         * Moves the newest B elements of _head, the ones next to the blocks,
+         * into a new first block.
+         */
+        void freeze_head () {
+            T v[B];
+            std::copy(_head.end() - B, _head.end(), v);
+            std::uint64_t* b = freeze(v);
+            try {
+                _blocks.push_front(b);}
+            catch (...) {
+                delete [] b;
+                throw;}
+            _head.erase_back(B);}
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        CompressedDeque () {}
+
+        CompressedDeque (const CompressedDeque& that) :
+                _head(that._head),
+                _tail(that._tail) {
+            try {
+                for (size_type j = 0; j != that._blocks.size(); ++j) {
+                    const std::uint64_t* b = that._blocks[j];
+                    const size_type n = block_words(b[WIDTH]);
+                    std::uint64_t* c = new std::uint64_t[n];
+                    std::copy(b, b + n, c);
+                    try {
+                        _blocks.push_back(c);}
+                    catch (...) {
+                        delete [] c;
+                        throw;}}}
+            catch (...) {
+                clear();
+                throw;}}
+
+        // ----------
+        // destructor
+        // ----------
+
+        ~CompressedDeque () {
+            clear();}
+
+        // ----------
+        // operator =
+        // ----------
+
+        CompressedDeque& operator = (const CompressedDeque& that) {
+            CompressedDeque x(that);
+            swap(x);
+            return *this;}
+
+        // -----------
+        // operator []
+        // -----------
+
+        /**
+         * @return element i, decoding at most one block
+         */
+        T operator [] (size_type i) const {
+            if (i < _head.size())
+                return _head[i];
+            i -= _head.size();
+            if (i < _blocks.size() * B)
+                return thaw_one(_blocks[i / B], i % B);
+            return _tail[i - _blocks.size() * B];}
+
+        // --
+        // at
+        // --
+
+        /**
+         * @throws out_of_range exception
+         */
+        T at (size_type i) const {
+            if (i >= size())
+                throw std::out_of_range("CompressedDeque::at()");
+            return (*this)[i];}
+
+        // ----------
+        // back/front
+        // ----------
+
+        T back () const {
+            assert(!empty());
+            if (!_tail.empty())
+                return _tail.back();
+            if (!_blocks.empty())
+                return static_cast<T>(_blocks.back()[LAST]);
+            return _head.back();}
+
+        T front () const {
+            assert(!empty());
+            if (!_head.empty())
+                return _head.front();
+            if (!_blocks.empty())
+                return static_cast<T>(_blocks.front()[BASE]);
+            return _tail.front();}
+
+        // -----
+        // bytes
+        // -----
+
+        /**
+         * @return the bytes the elements take: the ends at sizeof(T) each
+         * and every block's words and map slot, not counting row and map
+         * slack or allocator overhead
+         */
+        size_type bytes () const {
+            size_type n = (_head.size() + _tail.size()) * sizeof(T) + _blocks.size() * sizeof(std::uint64_t*);
+            for (size_type j = 0; j != _blocks.size(); ++j)
+                n += block_words(_blocks[j][WIDTH]) * sizeof(std::uint64_t);
+            return n;}
+
+        // -----
+        // clear
+        // -----
+
+        void clear () {
+            for (size_type j = 0; j != _blocks.size(); ++j)
+                delete [] _blocks[j];
+            _blocks.clear();
+            _head.clear();
+            _tail.clear();}
+
+        // -----
+        // empty
+        // -----
+
+        bool empty () const {
+            return !size();}
+
+        // ----------------
+        // for_each_segment
+        // ----------------
+
+        /**
+         * Calls f(p, n) for each run of contiguous elements in order, as
+         * MyDeque::for_each_segment() does; a block is decoded into a buffer
+         * that p points to for the length of the call.
+         * @param f is called as f(const T*, size_type)
+         */
+        template <typename F>
+        void for_each_segment (F f) const {
+            _head.for_each_segment(f);
+            T v[B];
+            for (size_type j = 0; j != _blocks.size(); ++j) {
+                thaw(_blocks[j], v);
+                f(static_cast<const T*>(v), B);}
+            _tail.for_each_segment(f);}
+
+        // ---
+        // pop
+        // ---
+
+        /**
+         * Removes the last element, thawing the last block when _tail is empty.
+         */
+        void pop_back () {
+            assert(!empty());
+            if (_tail.empty() && !_blocks.empty()) {
+                T v[B];
+                thaw(_blocks.back(), v);
+                _tail.push_back_n(v, B);
+                delete [] _blocks.back();
+                _blocks.pop_back();}
+            if (!_tail.empty())
+                _tail.pop_back();
+            else
+                _head.pop_back();
+            assert(valid());}
+
+        /**
+         * Removes the first element, thawing the first block when _head is empty.
+         */
+        void pop_front () {
+            assert(!empty());
+            if (_head.empty() && !_blocks.empty()) {
+                T v[B];
+                thaw(_blocks.front(), v);
+                _head.push_back_n(v, B);
+                delete [] _blocks.front();
+                _blocks.pop_front();}
+            if (!_head.empty())
+                _head.pop_front();
+            else
+                _tail.pop_front();
+            assert(valid());}
+
+        // ----
+        // push
+        // ----
+
+        /**
+         * Appends v, freezing B elements when _tail reaches 2 * B.
+         */
+        void push_back (const T& v) {
+            _tail.push_back(v);
+            if (_tail.size() == 2 * B) {
+                try {
+                    freeze_tail();}
+                catch (...) {
+                    _tail.pop_back();
+                    throw;}}
+            assert(valid());}
+
+        /**
+         * Prepends v, freezing B elements when _head reaches 2 * B.
+         */
+        void push_front (const T& v) {
+            _head.push_front(v);
+            if (_head.size() == 2 * B) {
+                try {
+                    freeze_head();}
+                catch (...) {
+                    _head.pop_front();
+                    throw;}}
+            assert(valid());}
+
+        // ----
+        // size
+        // ----
+
+        size_type size () const {
+            return _head.size() + _blocks.size() * B + _tail.size();}
+
+        // ----
+        // swap
+        // ----
+
+        void swap (CompressedDeque& that) {
+            _head.swap(that._head);
+            _blocks.swap(that._blocks);
+            _tail.swap(that._tail);}};
+
+template <typename T, std::size_t B>
+const typename CompressedDeque<T, B>::size_type CompressedDeque<T, B>::BLOCK_SIZE;
+
+#endif // CompressedDeque_h
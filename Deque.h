@@ -11,13 +11,27 @@
 // includes
 // --------
 
-#include <algorithm> // copy, equal, lexicographical_compare, max, swap
+#include <algorithm> // copy, copy_backward, equal, fill, lexicographical_compare, max, min, swap
 #include <cassert>   // assert
-#include <iterator>  // iterator, bidirectional_iterator_tag
-#include <memory>    // allocator
-#include <stdexcept> // out_of_range
-#include <utility>   // !=, <=, >, >=
-#include <iostream>
+#include <cerrno>    // errno, EINTR
+#include <cstddef>   // size_t
+#include <cstdint>   // uint32_t, uint64_t
+#include <cstring>   // memcmp, memcpy
+#include <functional> // less
+#include <istream>   // istream
+#include <iterator>  // iterator, make_move_iterator, random_access_iterator_tag, reverse_iterator
+#include <limits>    // numeric_limits
+#include <memory>    // allocator, allocator_traits
+#include <new>       // bad_alloc
+#include <ostream>   // ostream
+#include <stdexcept> // out_of_range, runtime_error
+#include <system_error> // system_error
+#include <type_traits> // aligned_storage, is_trivially_copyable
+#include <utility>   // !=, <=, >, >=, forward, move
+
+#include <sys/stat.h> // fstat, S_ISREG
+#include <sys/uio.h> // iovec, readv, writev
+#include <unistd.h>  // lseek, ssize_t
 
 // -----
 // using
@@ -36,7 +50,7 @@ template <typename A, typename BI>
 BI destroy (A& a, BI b, BI e) {
     while (b != e) {
         --e;
-        a.destroy(&*e);}
+        std::allocator_traits<A>::destroy(a, &*e);}
     return b;}
 
 // ------------------
@@ -48,7 +62,7 @@ BI uninitialized_copy (A& a, II b, II e, BI x) {
     BI p = x;
     try {
         while (b != e) {
-            a.construct(&*x, *b);
+            std::allocator_traits<A>::construct(a, &*x, *b);
             ++b;
             ++x;}}
     catch (...) {
@@ -65,18 +79,245 @@ BI uninitialized_fill (A& a, BI b, BI e, const U& v) {
     BI p = b;
     try {
         while (b != e) {
-            a.construct(&*b, v);
+            std::allocator_traits<A>::construct(a, &*b, v);
             ++b;}}
     catch (...) {
         destroy(a, p, b);
         throw;}
     return e;}
 
+// ---------------
+// deque_write_all
+// ---------------
+
+/**
+ * Writes every buffer in iov to fd, retrying after short writes and EINTR.
+ * @throws system_error if writev fails
+ */
+inline void deque_write_all (int fd, iovec* iov, int n) {
+    while (n) {
+        ssize_t w = ::writev(fd, iov, n);
+        if (w < 0) {
+            if (errno == EINTR)
+                continue;
+            throw std::system_error(errno, std::generic_category(), "MyDeque::write_to()");}
+        while (n && static_cast<std::size_t>(w) >= iov->iov_len) {
+            w -= iov->iov_len;
+            ++iov;
+            --n;}
+        if (n) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + w;
+            iov->iov_len -= w;}}}
+
+// --------------
+// deque_read_all
+// --------------
+
+/**
+ * Fills every buffer in iov from fd, retrying after short reads and EINTR.
+ * @throws system_error if readv fails, runtime_error at end of file
+ */
+inline void deque_read_all (int fd, iovec* iov, int n) {
+    while (n) {
+        ssize_t r = ::readv(fd, iov, n);
+        if (r < 0) {
+            if (errno == EINTR)
+                continue;
+            throw std::system_error(errno, std::generic_category(), "MyDeque::read_from()");}
+        if (r == 0)
+            throw std::runtime_error("MyDeque::read_from(): unexpected end of file");
+        while (n && static_cast<std::size_t>(r) >= iov->iov_len) {
+            r -= iov->iov_len;
+            ++iov;
+            --n;}
+        if (n) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + r;
+            iov->iov_len -= r;}}}
+
+// --------------
+// deque_prefetch
+// --------------
+
+/**
+ * Asks for the cache line holding p to be loaded for reading; never faults,
+ * so p may point anywhere. A no-op where the compiler has no prefetch hint.
+ */
+inline void deque_prefetch (const void* p) {
+#if defined(__GNUC__)
+    __builtin_prefetch(p, 0, 3);
+#else
+    (void)p;
+#endif
+    }
+
+// ------------
+// deque_header
+// ------------
+
+/**
+ * What save() and write_to() put in front of the elements.
+ */
+struct deque_header {
+    char          magic[4];   // "MYDQ"
+    std::uint32_t value_size; // sizeof(value_type)
+    std::uint64_t size;       // number of elements that follow
+
+    /**
+     * @return true if this header describes elements of value_size bytes
+     */
+    bool matches (std::uint32_t value_size) const {
+        return !std::memcmp(magic, "MYDQ", 4) && this->value_size == value_size;}};
+
+// --------------
+// deque_row_size
+// --------------
+
+/**
+ * The number of elements in each row of a MyDeque whose allocator is A.
+ * Allocation policies that want rows of a particular shape, such as whole
+ * cache lines, specialize it.
+ */
+template <typename A>
+struct deque_row_size {
+    static const std::size_t value = 5;};
+
+template <typename A>
+const std::size_t deque_row_size<A>::value;
+
+// -------------------
+// deque_inline_buffer
+// -------------------
+
+/**
+ * Rows and map slots that a MyDeque keeps inside the object itself.
+ * R is the number of inline rows of S elements each, and the inline map has
+ * 2 * R + 1 slots so that R rows and the end slot fit on either side of the
+ * centre. Rows are handed out by take_row() and returned by give_row().
+ */
+template <typename T, typename P, std::size_t R, std::size_t S>
+class deque_inline_buffer {
+    private:
+        typename std::aligned_storage<sizeof(T) * S, alignof(T)>::type _rows[R];
+        P _inline_map[2 * R + 1];
+        std::size_t _used;
+
+    public:
+        deque_inline_buffer () : _used(0) {
+            static_assert(R <= sizeof(std::size_t) * 8, "too many inline rows");}
+
+        /**
+         * @return the inline map
+         */
+        P* inline_map () {
+            return _inline_map;}
+
+        /**
+         * @return the number of slots in the inline map
+         */
+        std::size_t inline_slots () const {
+            return 2 * R + 1;}
+
+        /**
+         * @return a free inline row, or 0 if all are in use
+         */
+        P take_row () {
+            for (std::size_t i = 0; i != R; ++i)
+                if (!(_used & (std::size_t(1) << i))) {
+                    _used |= std::size_t(1) << i;
+                    return reinterpret_cast<P>(&_rows[i]);}
+            return 0;}
+
+        /**
+         * @return true if any inline row is in use
+         */
+        bool rows_in_use () const {
+            return _used;}
+
+        /**
+         * @param p is a row by value
+         * @return true if p was an inline row and is now free again
+         */
+        bool give_row (P p) {
+            P b = reinterpret_cast<P>(&_rows[0]);
+            std::less<P> lt;
+            if (lt(p, b) || !lt(p, b + R * S))
+                return false;
+            _used &= ~(std::size_t(1) << ((p - b) / S));
+            return true;}};
+
+template <typename T, typename P, std::size_t S>
+class deque_inline_buffer<T, P, 0, S> {
+    public:
+        P* inline_map () {
+            return 0;}
+
+        std::size_t inline_slots () const {
+            return 0;}
+
+        P take_row () {
+            return 0;}
+
+        bool rows_in_use () const {
+            return false;}
+
+        bool give_row (P) {
+            return false;}};
+
+// ------------
+// deque_growth
+// ------------
+
+/**
+ * How a MyDeque's map grows. With deque_doubling_growth, the default, the
+ * push that finds the map full copies every row pointer into a bigger map at
+ * once: O(1) amortized, but that one push pays for all the rows. With
+ * deque_incremental_growth the next map is allocated while the current one
+ * still has room, and each push that starts a row clears and fills a few of
+ * its slots, so no push copies more than a constant number of row pointers.
+ */
+struct deque_doubling_growth {};
+
+struct deque_incremental_growth {};
+
+/**
+ * What a MyDeque remembers about a map it is growing into: empty unless the
+ * growth is incremental.
+ */
+template <typename P, typename G>
+struct deque_map_migration {};
+
+template <typename P>
+struct deque_map_migration<P, deque_incremental_growth> {
+    P*          _next;      // the map being filled, or null
+    std::size_t _next_size; // its number of slots
+    std::size_t _from;      // slot _from of the current map is slot _to of _next
+    std::size_t _to;
+    std::size_t _lo;        // slots [_lo, _hi) of the current map are copied into _next
+    std::size_t _hi;
+    std::size_t _cleared;   // slots [0, _cleared) of _next are cleared or copied
+
+    deque_map_migration () :
+            _next(0)
+        {}};
+
 // -------
 // MyDeque
 // -------
 
-template < typename T, typename A = std::allocator<T> >
+/**
+ * A MyDeque is a map of row pointers plus the index of the front element and
+ * the number of elements. Element i lives in row (_start + i) / INNER_SIZE at
+ * offset (_start + i) % INNER_SIZE; slots that hold no elements are null.
+ * With a stateless allocator and N == 0, sizeof(MyDeque) is four words (32
+ * bytes on LP64, down from 72) and sizeof(iterator) is two words.
+ *
+ * N is the number of elements that are stored inside the MyDeque object
+ * itself. Until the deque outgrows them, rows come from the inline buffer and
+ * the map is the inline map, so small deques never touch the allocator.
+ *
+ * G is deque_doubling_growth or deque_incremental_growth; see deque_growth.
+ */
+template < typename T, typename A = std::allocator<T>, std::size_t N = 0, typename G = deque_doubling_growth >
 class MyDeque {
     public:
         // --------
@@ -86,19 +327,50 @@ class MyDeque {
         typedef A                                        allocator_type;
         typedef typename allocator_type::value_type      value_type;
 
-        typedef typename allocator_type::size_type       size_type;
-        typedef typename allocator_type::difference_type difference_type;
+        typedef typename std::allocator_traits<A>::size_type       size_type;
+        typedef typename std::allocator_traits<A>::difference_type difference_type;
 
-        typedef typename allocator_type::pointer         pointer;
-        typedef typename allocator_type::const_pointer   const_pointer;
+        typedef typename std::allocator_traits<A>::pointer         pointer;
+        typedef typename std::allocator_traits<A>::const_pointer   const_pointer;
 
-        typedef typename allocator_type::reference       reference;
-        typedef typename allocator_type::const_reference const_reference;
+        typedef value_type&                              reference;
+        typedef const value_type&                        const_reference;
 
-        typedef typename allocator_type::template rebind<pointer>::other outer_pointer;
+        typedef typename std::allocator_traits<A>::template rebind_alloc<pointer> map_allocator_type;
 
         //Size of inner row arrays.
-        const size_type static INNER_SIZE = 5;
+        const size_type static INNER_SIZE = deque_row_size<A>::value;
+
+        //Number of slots in the first heap allocated map.
+        const size_type static INITIAL_SLOTS = 8;
+
+        //Number of buffers handed to one readv or writev call.
+        const int static IOV_BATCH = 1024;
+
+        //How many rows ahead for_each_segment() prefetches by default.
+        const size_type static PREFETCH_ROWS = 16;
+
+        //With incremental growth, row pointers copied into the next map per push.
+        const size_type static MIGRATE_COPY_SLOTS = 8;
+
+        //With incremental growth, slots of the next map cleared per push.
+        const size_type static MIGRATE_CLEAR_SLOTS = 32;
+
+        //With incremental growth, maps with fewer rows in use than this grow at once.
+        const size_type static MIGRATE_MIN_ROWS = 64;
+
+        /**
+         * The raw representation of a MyDeque, for storage policies that
+         * persist or hand over the map and rows themselves.
+         */
+        struct layout {
+            pointer*  map;      // row pointers, null where there is no row
+            size_type map_size; // number of slots in map
+            size_type start;    // index of the front element, counted from slot 0
+            size_type size;};
+
+        //Number of inline rows; any N contiguous elements span at most this many rows.
+        const size_type static INLINE_ROWS = N ? (N + INNER_SIZE - 1) / INNER_SIZE + 1 : 0;
 
     public:
         // -----------
@@ -106,52 +378,59 @@ class MyDeque {
         // -----------
 
         /**
-         * @param lhs is a MyDeque by reference 
+         * @param lhs is a MyDeque by reference
          * @param rhs is a MyDeque by reference
          * @return bool true if lhs == rhs
          */
         friend bool operator == (const MyDeque& lhs, const MyDeque& rhs) {
-            if(lhs._size == 0 && rhs._size == 0)
-                return true;
-            if(lhs._size == 0 || rhs._size == 0)
-                return false;
-            if(lhs._size!=rhs._size)
-                return false;
-            return std::equal(const_cast<MyDeque&>(lhs).begin(), const_cast<MyDeque&>(lhs).end(), const_cast<MyDeque&>(rhs).begin());}
+            return (lhs.size() == rhs.size()) && std::equal(lhs.begin(), lhs.end(), rhs.begin());}
 
         // ----------
         // operator <
         // ----------
 
         /**
-         * @param lhs is a MyDeque by reference 
+         * @param lhs is a MyDeque by reference
          * @param rhs is a MyDeque by reference
          * @return bool true if lhs < rhs
          */
         friend bool operator < (const MyDeque& lhs, const MyDeque& rhs) {
-            if(lhs._size == 0 && rhs._size == 0)
-                return true;
             if(lhs._size == 0)
                 return true;
             if(lhs._size>rhs._size)
                 return false;
-            return std::lexicographical_compare(const_cast<MyDeque&>(lhs).begin(), const_cast<MyDeque&>(lhs).end(), const_cast<MyDeque&>(rhs).begin(), const_cast<MyDeque&>(rhs).end());}
+            return std::lexicographical_compare(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());}
 
     private:
+        // --------
+        // typedefs
+        // --------
+
+        typedef std::allocator_traits<allocator_type>     traits;
+        typedef std::allocator_traits<map_allocator_type> map_traits;
+        typedef deque_inline_buffer<value_type, pointer, INLINE_ROWS, INNER_SIZE> inline_buffer;
+
+        /**
+         * The map pointer, with the allocator, the inline buffer and the
+         * migration state as bases so that they take no room when they are
+         * empty.
+         */
+        struct map_holder : allocator_type, inline_buffer, deque_map_migration<pointer, G> {
+            pointer* _p;
+
+            explicit map_holder (const allocator_type& a) :
+                    allocator_type(a),
+                    _p(0)
+                {}};
+
         // ----
         // data
         // ----
 
-        allocator_type _a;
-        outer_pointer _astar;
-        pointer* _outer_begin;
-        pointer* _outer_end;
-        pointer* _outer_very_begin;
-        pointer* _outer_very_end;
-        pointer _data_begin;
-        pointer _data_end;
-        size_type _size;
-        size_type _capacity;
+        map_holder _map;      // row pointers, null where there is no row
+        size_type  _map_size; // number of slots in _map
+        size_type  _start;    // index of the front element, counted from slot 0
+        size_type  _size;
 
     private:
         // -----
@@ -159,24 +438,248 @@ class MyDeque {
         // -----
 
         bool valid () const {
-            return _outer_very_begin <= _outer_very_end && _capacity >= 0 && _size >= 0;}
+            if (!_map._p)
+                return !_map_size && !_size;
+            return _start + _size < _map_size * INNER_SIZE;}
+
+        // ---------
+        // allocator
+        // ---------
+
+        allocator_type& alloc () {
+            return _map;}
+
+        // ----
+        // rows
+        // ----
+
+        /**
+         * @return a row of INNER_SIZE elements, from the inline buffer if one is free
+         */
+        pointer allocate_row () {
+            pointer p = _map.take_row();
+            return p ? p : traits::allocate(alloc(), INNER_SIZE);}
+
+        /**
+         * @param p is a row returned by allocate_row
+         */
+        void deallocate_row (pointer p) {
+            if (!_map.give_row(p))
+                traits::deallocate(alloc(), p, INNER_SIZE);}
+
+        // ---
+        // map
+        // ---
+
+        /**
+         * @param n is the number of slots
+         * @return a map of n null slots
+         */
+        pointer* allocate_map (size_type n) {
+            map_allocator_type ma(alloc());
+            pointer* m = map_traits::allocate(ma, n);
+            std::fill(m, m + n, pointer());
+            return m;}
+
+        /**
+         * @param m is a map of n slots from allocate_map
+         */
+        void free_map (pointer* m, size_type n) {
+            map_allocator_type ma(alloc());
+            map_traits::deallocate(ma, m, n);}
+
+        /**
+         * Releases the map unless it is the inline one, and any map it was
+         * growing into.
+         */
+        void deallocate_map () {
+            cancel_migration(G());
+            if (_map._p && _map._p != _map.inline_map())
+                free_map(_map._p, _map_size);}
+
+        // ---------
+        // migration
+        // ---------
+
+        /**
+         * @param lo is set to the first slot that holds a row
+         * @param hi is set to one past the last
+         */
+        void row_slots (size_type& lo, size_type& hi) const {
+            lo = _start / INNER_SIZE;
+            hi = _size ? (_start + _size + INNER_SIZE - 1) / INNER_SIZE : lo + (_map._p[lo] ? 1 : 0);}
+
+        void cancel_migration (deque_doubling_growth) {}
+
+        /**
+         * Forgets the map being grown into.
+         */
+        void cancel_migration (deque_incremental_growth) {
+            if (_map._next) {
+                free_map(_map._next, _map._next_size);
+                _map._next = 0;}}
+
+        void trim_migration (deque_doubling_growth) {}
+
+        /**
+         * Stops mirroring the slots that no longer hold rows, clearing them
+         * in the next map. Called after anything that releases rows.
+         */
+        void trim_migration (deque_incremental_growth) {
+            if (!_map._next)
+                return;
+            size_type lo, hi;
+            row_slots(lo, hi);
+            size_type& a = _map._lo;
+            size_type& b = _map._hi;
+            const size_type na = std::max(a, lo);
+            const size_type nb = std::max(na, std::min(b, hi));
+            for (; a < na && a < b; ++a)
+                _map._next[a + _map._to - _map._from] = pointer();
+            for (; b > nb; --b)
+                _map._next[b - 1 + _map._to - _map._from] = pointer();
+            if (a == b)
+                a = b = lo;}
+
+        bool advance_migration (deque_doubling_growth, size_type, size_type) {
+            return false;}
+
+        /**
+         * Starts growing into a map four times the rows in use once the rows
+         * come within half their number of either end of the current map;
+         * then clears up to clear slots of the next map and copies up to copy
+         * row pointers into it. Once every row is mirrored and the next map
+         * is clear, it replaces the current one. If the rows no longer fit
+         * the next map, it is abandoned.
+         * @return true if the map was replaced
+         */
+        bool advance_migration (deque_incremental_growth, size_type copy, size_type clear) {
+            if (!_map._p || _map._p == _map.inline_map())
+                return false;
+            size_type lo, hi;
+            row_slots(lo, hi);
+            if (!_map._next) {
+                const size_type used = hi - lo;
+                if (used < MIGRATE_MIN_ROWS || 2 * std::min(lo, _map_size - hi) > used)
+                    return false;
+                map_allocator_type ma(alloc());
+                _map._next      = map_traits::allocate(ma, 4 * used);
+                _map._next_size = 4 * used;
+                _map._from      = lo;
+                _map._to        = (_map._next_size - used) / 2;
+                _map._lo        = lo;
+                _map._hi        = lo;
+                _map._cleared   = 0;}
+            else
+                trim_migration(deque_incremental_growth());
+            if (lo + _map._to < _map._from || hi + _map._to >= _map._next_size + _map._from) {
+                cancel_migration(deque_incremental_growth());
+                return false;}
+            pointer* const n     = _map._next;
+            const size_type to   = _map._to;
+            const size_type from = _map._from;
+            for (size_type e = _map._cleared + std::min(clear, _map._next_size - _map._cleared); _map._cleared != e; ++_map._cleared) {
+                const size_type j = _map._cleared;
+                if (j < _map._lo + to - from || j >= _map._hi + to - from)
+                    n[j] = pointer();}
+            for (; copy && _map._hi != hi; --copy, ++_map._hi)
+                n[_map._hi + to - from] = _map._p[_map._hi];
+            for (; copy && _map._lo != lo; --copy)
+                --_map._lo, n[_map._lo + to - from] = _map._p[_map._lo];
+            if (_map._lo != lo || _map._hi != hi || _map._cleared != _map._next_size)
+                return false;
+            free_map(_map._p, _map_size);
+            _map._p   = n;
+            _map_size = _map._next_size;
+            _start    = (lo + to - from) * INNER_SIZE + _start % INNER_SIZE;
+            _map._next = 0;
+            assert(valid());
+            return true;}
+
+        /**
+         * Advances the migration by one row's worth per row in rows; pushes
+         * call it when they start a row.
+         */
+        void step_migration (size_type rows = 1) {
+            advance_migration(G(), rows * MIGRATE_COPY_SLOTS, rows * MIGRATE_CLEAR_SLOTS);}
+
+        /**
+         * Makes room in the map for one more element at the front or back.
+         * Rows are recentred in the existing map while it is at most half
+         * full (or, for several rows at once, while they fit), otherwise the
+         * map doubles until they fit. Rows themselves never move. A map that
+         * was being grown into incrementally is finished first.
+         * @param front is true to make room at the front
+         * @param rows is the number of free slots needed on that side -- defaulted
+         */
+        void reserve_map (bool front, size_type rows = 1) {
+            if (advance_migration(G(), size_type(-1), size_type(-1))) {
+                if (front ? _start / INNER_SIZE >= rows : (_start + _size) / INNER_SIZE + rows < _map_size)
+                    return;}
+            else
+                cancel_migration(G());
+            if (!_map._p) {
+                _map_size = _map.inline_slots();
+                if (_map_size) {
+                    _map._p = _map.inline_map();
+                    std::fill(_map._p, _map._p + _map_size, pointer());
+                } else {
+                    _map_size = INITIAL_SLOTS;
+                    _map._p = allocate_map(_map_size);}
+                _start = (_map_size / 2) * INNER_SIZE + INNER_SIZE / 2;
+                return;}
+
+            const size_type first = _start / INNER_SIZE;
+            const size_type used  = (_start + _size) / INNER_SIZE - first + 1;
+            const size_type need  = used + rows;
+            const bool in_place   = (need * 2 <= _map_size + rows + 1) || ((rows > 1 || _map._p == _map.inline_map()) && need <= _map_size);
+            size_type slots = _map_size;
+            if (!in_place)
+                do
+                    slots *= 2;
+                while (need > slots);
+            const size_type free  = slots - used;
+            const size_type new_first = front ? std::max(free - free / 2, rows) : std::min(free / 2, free - rows);
+
+            pointer* const m = _map._p;
+            if (in_place) {
+                if (new_first < first) {
+                    std::copy(m + first, m + first + used, m + new_first);
+                    std::fill(m + std::max(first, new_first + used), m + first + used, pointer());
+                } else {
+                    std::copy_backward(m + first, m + first + used, m + new_first + used);
+                    std::fill(m + first, m + std::min(first + used, new_first), pointer());}
+            } else {
+                pointer* const n = allocate_map(slots);
+                std::copy(m + first, m + first + used, n + new_first);
+                deallocate_map();
+                _map._p = n;
+                _map_size = slots;}
+            _start = new_first * INNER_SIZE + _start % INNER_SIZE;}
 
     public:
         // --------
         // iterator
         // --------
 
+        class const_iterator;
+
+        /**
+         * Two words: the map slot of the current row and the current element.
+         */
         class iterator {
+            private:
+                friend class const_iterator;
+
             public:
                 // --------
                 // typedefs
                 // --------
 
-                typedef std::bidirectional_iterator_tag   iterator_category;
+                typedef std::random_access_iterator_tag   iterator_category;
                 typedef typename MyDeque::value_type      value_type;
                 typedef typename MyDeque::difference_type difference_type;
                 typedef typename MyDeque::pointer         pointer;
-                typedef typename MyDeque::outer_pointer outer_pointer;
                 typedef typename MyDeque::reference       reference;
 
             public:
@@ -185,56 +688,83 @@ class MyDeque {
                 // -----------
 
                 /**
-                 * @param lhs is a MyDeque::iterator by reference 
+                 * @param lhs is a MyDeque::iterator by reference
                  * @param rhs is a MyDeque::iterator by reference
                  * @return bool true if lhs iterator location is equal to rhs iterator location
                  */
                 friend bool operator == (const iterator& lhs, const iterator& rhs) {
-                    
-                    return lhs._iterator_location == rhs._iterator_location;}
+                    return lhs._cur == rhs._cur;}
 
                 /**
-                 * @param lhs is a MyDeque::iterator by reference 
+                 * @param lhs is a MyDeque::iterator by reference
                  * @param rhs is a MyDeque::iterator by reference
                  * @return bool true if lhs iterator location is not equal to rhs iterator location
                  */
                 friend bool operator != (const iterator& lhs, const iterator& rhs) {
                     return !(lhs == rhs);}
 
+                // ----------
+                // operator <
+                // ----------
+
+                /**
+                 * @param lhs is a MyDeque::iterator by reference
+                 * @param rhs is a MyDeque::iterator by reference
+                 * @return bool true if lhs is before rhs
+                 */
+                friend bool operator < (const iterator& lhs, const iterator& rhs) {
+                    return (lhs._node < rhs._node) || (lhs._node == rhs._node && lhs._cur < rhs._cur);}
+
                 // ----------
                 // operator +
                 // ----------
 
                 /**
-                 * @param lhs is a MyDeque::iterator by value 
+                 * @param lhs is a MyDeque::iterator by value
                  * @param rhs is a difference_type by value
                  * @return an iterator stepped by value rhs
                  */
                 friend iterator operator + (iterator lhs, difference_type rhs) {
                     return lhs += rhs;}
 
+                /**
+                 * @param lhs is a difference_type by value
+                 * @param rhs is a MyDeque::iterator by value
+                 * @return an iterator stepped by value lhs
+                 */
+                friend iterator operator + (difference_type lhs, iterator rhs) {
+                    return rhs += lhs;}
+
                 // ----------
                 // operator -
                 // ----------
 
                 /**
-                 * @param lhs is a MyDeque::iterator by value 
+                 * @param lhs is a MyDeque::iterator by value
                  * @param rhs is a difference_type by value
                  * @return an iterator stepped back by value rhs
                  */
                 friend iterator operator - (iterator lhs, difference_type rhs) {
                     return lhs -= rhs;}
 
+                /**
+                 * @param lhs is a MyDeque::iterator by reference
+                 * @param rhs is a MyDeque::iterator by reference
+                 * @return the number of elements from rhs to lhs
+                 */
+                friend difference_type operator - (const iterator& lhs, const iterator& rhs) {
+                    if (lhs._node == rhs._node)
+                        return lhs._cur - rhs._cur;
+                    return (lhs._node - rhs._node) * difference_type(INNER_SIZE)
+                         + (lhs._cur - *lhs._node) - (rhs._cur - *rhs._node);}
+
             private:
                 // ----
                 // data
                 // ----
 
-                pointer* _outer_begin;
-                pointer _iterator_location;
-                size_type _iterator_location_outer;
-                size_type _room_on_row;
-                pointer _data_end;
+                pointer* _node;
+                pointer  _cur;
 
             private:
                 // -----
@@ -242,7 +772,7 @@ class MyDeque {
                 // -----
 
                 bool valid () const {
-                    return _outer_begin!=0;}
+                    return _node != 0 || _cur == 0;}
 
             public:
                 // -----------
@@ -252,20 +782,18 @@ class MyDeque {
                 /**
                  * default constructor
                  */
-                iterator (){
+                iterator () :
+                        _node(0),
+                        _cur(0)
+                    {}
 
-                } 
                 /**
-                * @param outer is a pointer to a MyDeque
-                * constructs an iterator for a MyDeque
-                */
-                iterator (MyDeque<T,A>* outer): 
-                    _outer_begin(outer->_outer_begin),
-                    _iterator_location(outer->_data_begin),
-                    _data_end(outer->_data_end)
-                {
-                    _room_on_row = INNER_SIZE - (_iterator_location - *_outer_begin) - 1;
-                    _iterator_location_outer = 0;
+                 * @param node is the map slot of the row cur is in
+                 * @param cur is a pointer to the element
+                 */
+                iterator (pointer* node, pointer cur) :
+                        _node(node),
+                        _cur(cur) {
                     assert(valid());}
 
                 // Default copy, destructor, and copy assignment.
@@ -278,23 +806,33 @@ class MyDeque {
                 // ----------
 
                 /**
-                 * @return reference to value type 
+                 * @return reference to value type
                  * Operator returns value at iterator location
                  */
                 reference operator * () const {
-                    return *_iterator_location;
-                }
+                    return *_cur;}
 
                 // -----------
                 // operator ->
                 // -----------
 
                 /**
-                 * @return pointer to value type location 
+                 * @return pointer to value type location
                  */
                 pointer operator -> () const {
                     return &**this;}
 
+                // -----------
+                // operator []
+                // -----------
+
+                /**
+                 * @param d is difference_type
+                 * @return reference to the value d elements away
+                 */
+                reference operator [] (difference_type d) const {
+                    return *(*this + d);}
+
                 // -----------
                 // operator ++
                 // -----------
@@ -303,26 +841,14 @@ class MyDeque {
                  * @return iterator reference -- self pre increment
                  */
                 iterator& operator ++ () {
-                    
-                    if(_iterator_location == _data_end - 1){
-                            ++_iterator_location;
-                            
-                            return *this;}
-                    if(_room_on_row) {
-                        ++_iterator_location;
-                        --_room_on_row;
-                    }else{
-                        ++_iterator_location_outer;
-                        _iterator_location = *(_outer_begin + _iterator_location_outer);
-                        _room_on_row = INNER_SIZE - 1;
-                    }
-                    
-
+                    if (++_cur == *_node + INNER_SIZE) {
+                        ++_node;
+                        _cur = *_node;}
                     assert(valid());
                     return *this;}
 
                 /**
-                 * @return iterator -- self post increment 
+                 * @return iterator -- self post increment
                  */
                 iterator operator ++ (int) {
                     iterator x = *this;
@@ -338,17 +864,10 @@ class MyDeque {
                  * @return iterator reference -- self pre decrement
                  */
                 iterator& operator -- () {
-                    
-                    bool endCase = _iterator_location == _data_end;
-                    if(INNER_SIZE - _room_on_row || endCase) {
-                        --_iterator_location;
-                        if(!endCase)
-                            ++_room_on_row;
-                    }else{
-                        --_iterator_location_outer;
-                        _iterator_location = *(_outer_begin + _iterator_location_outer) + INNER_SIZE - 1;
-                        _room_on_row = 0;
-                    }
+                    if (_cur == *_node) {
+                        --_node;
+                        _cur = *_node + INNER_SIZE;}
+                    --_cur;
                     assert(valid());
                     return *this;}
 
@@ -366,13 +885,20 @@ class MyDeque {
                 // -----------
 
                 /**
-                 * @param d is difference_type 
+                 * @param d is difference_type
                  * @return iterator by reference stepped by d
                  */
                 iterator& operator += (difference_type d) {
-                    while(d){
-                        ++*this;
-                        --d;};
+                    if (!d)
+                        return *this;
+                    const difference_type rows   = INNER_SIZE;
+                    const difference_type offset = (_cur - *_node) + d;
+                    if (offset >= 0 && offset < rows)
+                        _cur += d;
+                    else {
+                        const difference_type r = (offset >= 0) ? offset / rows : -((-offset - 1) / rows) - 1;
+                        _node += r;
+                        _cur = *_node + (offset - r * rows);}
                     assert(valid());
                     return *this;}
 
@@ -381,28 +907,27 @@ class MyDeque {
                 // -----------
 
                 /**
-                 * @param d is difference_type 
+                 * @param d is difference_type
                  * @return iterator by reference stepped back by d
                  */
                 iterator& operator -= (difference_type d) {
-                    while(d){
-                        --*this;
-                        --d;};
-                    assert(valid());
-                    return *this;}};
+                    return *this += -d;}};
 
     public:
         // --------------
         // const_iterator
         // --------------
 
+        /**
+         * The same two words as iterator, read-only; an iterator converts to one.
+         */
         class const_iterator {
             public:
                 // --------
                 // typedefs
                 // --------
 
-                typedef std::bidirectional_iterator_tag   iterator_category;
+                typedef std::random_access_iterator_tag   iterator_category;
                 typedef typename MyDeque::value_type      value_type;
                 typedef typename MyDeque::difference_type difference_type;
                 typedef typename MyDeque::const_pointer   pointer;
@@ -414,53 +939,83 @@ class MyDeque {
                 // -----------
 
                 /**
-                 * @param lhs is a MyDeque::const_iterator by reference 
+                 * @param lhs is a MyDeque::const_iterator by reference
                  * @param rhs is a MyDeque::const_iterator by reference
-                 * @return bool true if lhs iterator location is equal to rhs iterator location
+                 * @return bool true if lhs const_iterator location is equal to rhs const_iterator location
                  */
                 friend bool operator == (const const_iterator& lhs, const const_iterator& rhs) {
-                    return lhs._normal_it == rhs._normal_it;}
+                    return lhs._cur == rhs._cur;}
 
                 /**
-                 * @param lhs is a MyDeque::const_iterator by reference 
+                 * @param lhs is a MyDeque::const_iterator by reference
                  * @param rhs is a MyDeque::const_iterator by reference
-                 * @return bool true if lhs iterator location is not equal to rhs iterator location
+                 * @return bool true if lhs const_iterator location is not equal to rhs const_iterator location
                  */
                 friend bool operator != (const const_iterator& lhs, const const_iterator& rhs) {
                     return !(lhs == rhs);}
 
+                // ----------
+                // operator <
+                // ----------
+
+                /**
+                 * @param lhs is a MyDeque::const_iterator by reference
+                 * @param rhs is a MyDeque::const_iterator by reference
+                 * @return bool true if lhs is before rhs
+                 */
+                friend bool operator < (const const_iterator& lhs, const const_iterator& rhs) {
+                    return (lhs._node < rhs._node) || (lhs._node == rhs._node && lhs._cur < rhs._cur);}
+
                 // ----------
                 // operator +
                 // ----------
 
                 /**
-                 * @param lhs is a MyDeque::const_iterator by value 
+                 * @param lhs is a MyDeque::const_iterator by value
                  * @param rhs is a difference_type by value
-                 * @return an const_iterator stepped by value rhs
+                 * @return a const_iterator stepped by value rhs
                  */
                 friend const_iterator operator + (const_iterator lhs, difference_type rhs) {
                     return lhs += rhs;}
 
+                /**
+                 * @param lhs is a difference_type by value
+                 * @param rhs is a MyDeque::const_iterator by value
+                 * @return a const_iterator stepped by value lhs
+                 */
+                friend const_iterator operator + (difference_type lhs, const_iterator rhs) {
+                    return rhs += lhs;}
+
                 // ----------
                 // operator -
                 // ----------
 
                 /**
-                 * @param lhs is a MyDeque::const_iterator by value 
+                 * @param lhs is a MyDeque::const_iterator by value
                  * @param rhs is a difference_type by value
-                 * @return an const_iterator stepped back by value rhs
+                 * @return a const_iterator stepped back by value rhs
                  */
                 friend const_iterator operator - (const_iterator lhs, difference_type rhs) {
                     return lhs -= rhs;}
 
+                /**
+                 * @param lhs is a MyDeque::const_iterator by reference
+                 * @param rhs is a MyDeque::const_iterator by reference
+                 * @return the number of elements from rhs to lhs
+                 */
+                friend difference_type operator - (const const_iterator& lhs, const const_iterator& rhs) {
+                    if (lhs._node == rhs._node)
+                        return lhs._cur - rhs._cur;
+                    return (lhs._node - rhs._node) * difference_type(INNER_SIZE)
+                         + (lhs._cur - *lhs._node) - (rhs._cur - *rhs._node);}
+
             private:
                 // ----
                 // data
                 // ----
 
-                MyDeque::iterator _normal_it;
-
-                
+                const typename MyDeque::pointer* _node;
+                pointer                          _cur;
 
             private:
                 // -----
@@ -468,7 +1023,7 @@ class MyDeque {
                 // -----
 
                 bool valid () const {
-                    return true;}
+                    return _node != 0 || _cur == 0;}
 
             public:
                 // -----------
@@ -476,18 +1031,30 @@ class MyDeque {
                 // -----------
 
                 /**
-                * default constructor
-                */
-                const_iterator(){
-
-                }
+                 * default constructor
+                 */
+                const_iterator () :
+                        _node(0),
+                        _cur(0)
+                    {}
 
                 /**
-                 *@param outer is const MyDeque pointer  
+                 * @param node is the map slot of the row cur is in
+                 * @param cur is a pointer to the element
                  */
-                const_iterator (const MyDeque* outer):_normal_it(const_cast<MyDeque*>(outer)) {
+                const_iterator (const typename MyDeque::pointer* node, pointer cur) :
+                        _node(node),
+                        _cur(cur) {
                     assert(valid());}
 
+                /**
+                 * @param it is an iterator by reference
+                 */
+                const_iterator (const typename MyDeque::iterator& it) :
+                        _node(it._node),
+                        _cur(it._cur)
+                    {}
+
                 // Default copy, destructor, and copy assignment.
                 // const_iterator (const const_iterator&);
                 // ~const_iterator ();
@@ -498,35 +1065,48 @@ class MyDeque {
                 // ----------
 
                 /**
-                 * @return const_reference to value type at iterator location 
+                 * @return const_reference to the value at the const_iterator location
                  */
-                const_reference operator * () const {
-                    return const_cast<const_reference>(*_normal_it);}
+                reference operator * () const {
+                    return *_cur;}
 
                 // -----------
                 // operator ->
                 // -----------
 
                 /**
-                 * @return pointer to value type at iterator location
+                 * @return const_pointer to the value
                  */
                 pointer operator -> () const {
                     return &**this;}
 
+                // -----------
+                // operator []
+                // -----------
+
+                /**
+                 * @param d is difference_type
+                 * @return reference to the value d elements away
+                 */
+                reference operator [] (difference_type d) const {
+                    return *(*this + d);}
+
                 // -----------
                 // operator ++
                 // -----------
 
                 /**
-                 * @return const_iterator as a reference pointing at incremented location -- pre increment
+                 * @return const_iterator reference -- self pre increment
                  */
                 const_iterator& operator ++ () {
+                    if (++_cur == *_node + INNER_SIZE) {
+                        ++_node;
+                        _cur = *_node;}
                     assert(valid());
-                    ++_normal_it;
                     return *this;}
 
                 /**
-                 * @return const_iterator by value -- post increment 
+                 * @return const_iterator -- self post increment
                  */
                 const_iterator operator ++ (int) {
                     const_iterator x = *this;
@@ -539,15 +1119,18 @@ class MyDeque {
                 // -----------
 
                 /**
-                 * @return const_iterator as a reference pointing at decremented location -- pre increment
+                 * @return const_iterator reference -- self pre decrement
                  */
                 const_iterator& operator -- () {
+                    if (_cur == *_node) {
+                        --_node;
+                        _cur = *_node + INNER_SIZE;}
+                    --_cur;
                     assert(valid());
-                    --_normal_it;
                     return *this;}
 
                 /**
-                 * @return const_iterator by value -- post decrement
+                 * @return const_iterator -- self post decrement
                  */
                 const_iterator operator -- (int) {
                     const_iterator x = *this;
@@ -560,12 +1143,21 @@ class MyDeque {
                 // -----------
 
                 /**
-                 * @param d is difference_type by value 
+                 * @param d is difference_type
                  * @return const_iterator by reference stepped by d
                  */
                 const_iterator& operator += (difference_type d) {
+                    if (!d)
+                        return *this;
+                    const difference_type rows   = INNER_SIZE;
+                    const difference_type offset = (_cur - *_node) + d;
+                    if (offset >= 0 && offset < rows)
+                        _cur += d;
+                    else {
+                        const difference_type r = (offset >= 0) ? offset / rows : -((-offset - 1) / rows) - 1;
+                        _node += r;
+                        _cur = *_node + (offset - r * rows);}
                     assert(valid());
-                    _normal_it += d;
                     return *this;}
 
                 // -----------
@@ -573,13 +1165,204 @@ class MyDeque {
                 // -----------
 
                 /**
-                 * @param d is difference_type by value 
+                 * @param d is difference_type
                  * @return const_iterator by reference stepped back by d
                  */
                 const_iterator& operator -= (difference_type d) {
-                    assert(valid());
-                    _normal_it -= d;
-                    return *this;}};
+                    return *this += -d;}};
+
+        typedef std::reverse_iterator<iterator>       reverse_iterator;
+        typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+        // -----------
+        // const_slice
+        // -----------
+
+        /**
+         * A read-only view of [first, last) of a MyDeque: the map, the
+         * position of first and a size, so making one is O(1) and copies no
+         * elements. It is invalidated by whatever invalidates the deque's
+         * iterators.
+         */
+        class const_slice {
+            public:
+                // --------
+                // typedefs
+                // --------
+
+                typedef typename MyDeque::value_type             value_type;
+                typedef typename MyDeque::size_type              size_type;
+                typedef typename MyDeque::difference_type        difference_type;
+                typedef typename MyDeque::const_reference        reference;
+                typedef typename MyDeque::const_reference        const_reference;
+                typedef typename MyDeque::const_iterator         iterator;
+                typedef typename MyDeque::const_iterator         const_iterator;
+                typedef typename MyDeque::const_reverse_iterator reverse_iterator;
+                typedef typename MyDeque::const_reverse_iterator const_reverse_iterator;
+
+            private:
+                friend class MyDeque;
+
+                // ----
+                // data
+                // ----
+
+                const typename MyDeque::pointer* _map;
+                size_type                        _first; // position of the first element in _map
+                size_type                        _size;
+
+            private:
+                const_slice (const typename MyDeque::pointer* map, size_type first, size_type n) :
+                        _map(map),
+                        _first(first),
+                        _size(n)
+                    {}
+
+            public:
+                // ------------
+                // constructors
+                // ------------
+
+                /**
+                 * default constructor, an empty view
+                 */
+                const_slice () :
+                        _map(0),
+                        _first(0),
+                        _size(0)
+                    {}
+
+                /**
+                 * @param d is the MyDeque to view the whole of
+                 */
+                const_slice (const MyDeque& d) :
+                        _map(d._map._p),
+                        _first(d._start),
+                        _size(d._size)
+                    {}
+
+                // -----------
+                // operator []
+                // -----------
+
+                /**
+                 * @param i is an index in [0, size())
+                 * @return const_reference to element i of the view
+                 */
+                const_reference operator [] (size_type i) const {
+                    const size_type k = _first + i;
+                    return _map[k / INNER_SIZE][k % INNER_SIZE];}
+
+                // ----------
+                // back/front
+                // ----------
+
+                const_reference back () const {
+                    return (*this)[_size - 1];}
+
+                const_reference front () const {
+                    return (*this)[0];}
+
+                // ---------
+                // begin/end
+                // ---------
+
+                const_iterator begin () const {
+                    return const_iterator_at(_map, _first);}
+
+                const_iterator end () const {
+                    return const_iterator_at(_map, _first + _size);}
+
+                const_reverse_iterator rbegin () const {
+                    return const_reverse_iterator(end());}
+
+                const_reverse_iterator rend () const {
+                    return const_reverse_iterator(begin());}
+
+                // -----
+                // empty
+                // -----
+
+                bool empty () const {
+                    return !_size;}
+
+                // ----------------
+                // for_each_segment
+                // ----------------
+
+                /**
+                 * Calls f(p, n) for each run of n contiguous elements starting
+                 * at p, front to back. Every run but the first and last is a
+                 * whole row. Before each row is handed to f, the row ahead rows
+                 * further on is prefetched, and the map slot twice as far, so
+                 * that on a cold deque the loads of later rows overlap with the
+                 * work on this one.
+                 * @param f is a function object taking (const_pointer, size_type)
+                 * @param ahead is the prefetch distance in rows, 0 for none -- defaulted
+                 */
+                template <typename F>
+                void for_each_segment (F f, size_type ahead = PREFETCH_ROWS) const {
+                    if (!_size)
+                        return;
+                    size_type k = _first;
+                    const size_type e = _first + _size;
+                    const size_type last = (e - 1) / INNER_SIZE;
+                    while (k != e) {
+                        const size_type r = k / INNER_SIZE;
+                        if (ahead) {
+                            deque_prefetch(_map + std::min(r + 2 * ahead, last));
+                            if (r + ahead <= last)
+                                deque_prefetch(&*_map[r + ahead]);}
+                        const size_type n = std::min(e - k, INNER_SIZE - k % INNER_SIZE);
+                        f(const_pointer(_map[r] + k % INNER_SIZE), n);
+                        k += n;}}
+
+                // ----
+                // size
+                // ----
+
+                size_type size () const {
+                    return _size;}
+
+                // -----
+                // slice
+                // -----
+
+                /**
+                 * @param first is an index in [0, size()]
+                 * @param last is an index in [first, size()]
+                 * @return a const_slice of [first, last) of this view
+                 */
+                const_slice slice (size_type first, size_type last) const {
+                    assert(first <= last && last <= _size);
+                    return const_slice(_map, _first + first, last - first);}};
+
+    private:
+        // -----------
+        // iterator_at
+        // -----------
+
+        /**
+         * @param i is an index in [0, size()]
+         * @return iterator to element i
+         */
+        iterator iterator_at (size_type i) const {
+            if (!_map._p)
+                return iterator();
+            const size_type k = _start + i;
+            pointer* node = _map._p + k / INNER_SIZE;
+            return iterator(node, *node ? *node + k % INNER_SIZE : pointer());}
+
+        /**
+         * @param map is a map, or null
+         * @param k is a position in it, counting from the start of row 0
+         * @return const_iterator to position k
+         */
+        static const_iterator const_iterator_at (const pointer* map, size_type k) {
+            if (!map)
+                return const_iterator();
+            const pointer* node = map + k / INNER_SIZE;
+            return const_iterator(node, *node ? const_pointer(*node + k % INNER_SIZE) : const_pointer());}
 
     public:
         // ------------
@@ -588,17 +1371,13 @@ class MyDeque {
 
         /**
          * default constructor
-         * @param a is an allocator_type by refernce -- defaulted 
-         */
-        explicit MyDeque (const allocator_type& a = allocator_type()) : _a(a) {
-            _outer_begin = 0;
-            _outer_end = 0;
-            _outer_very_begin = 0;
-            _outer_very_end = 0;
-            _data_end = 0;
-            _data_begin = 0;
-            _size = 0;
-            _capacity = 0;
+         * @param a is an allocator_type by refernce -- defaulted
+         */
+        explicit MyDeque (const allocator_type& a = allocator_type()) :
+                _map(a),
+                _map_size(0),
+                _start(0),
+                _size(0) {
             assert(valid());}
 
         /**
@@ -606,16 +1385,11 @@ class MyDeque {
          * @param v is const_reference by value -- defaulted
          * @param a is allocator_type by reference
          */
-        explicit MyDeque (size_type s, const_reference v = value_type(), const allocator_type& a = allocator_type()) {            
-            _outer_begin = 0;
-            _outer_end = 0;
-            _outer_very_begin = 0;
-            _outer_very_end = 0;
-            _data_end = 0;
-            _data_begin = 0;
-            _size = 0;
-            _capacity = 0;
-            
+        explicit MyDeque (size_type s, const_reference v = value_type(), const allocator_type& a = allocator_type()) :
+                _map(a),
+                _map_size(0),
+                _start(0),
+                _size(0) {
             while(s){
                 push_back(v);
                 --s;
@@ -624,20 +1398,27 @@ class MyDeque {
 
         /**
          * copy constructor
-         * @param that is a MyDeque passed by reference 
-         */
-        MyDeque (const MyDeque& that){
-            _outer_begin = 0;
-            _outer_end = 0;
-            _outer_very_begin = 0;
-            _outer_very_end = 0;
-            _data_end = 0;
-            _data_begin = 0;
-            _size = 0;
-            _capacity = 0;
-
+         * @param that is a MyDeque passed by reference
+         */
+        MyDeque (const MyDeque& that) :
+                _map(traits::select_on_container_copy_construction(that._map)),
+                _map_size(0),
+                _start(0),
+                _size(0) {
             *this = that;
+            assert(valid());}
 
+        /**
+         * move constructor; takes over the rows of that unless there is
+         * inline storage, in which case the elements are moved
+         * @param that is a MyDeque by rvalue reference
+         */
+        MyDeque (MyDeque&& that) :
+                _map(that.alloc()),
+                _map_size(0),
+                _start(0),
+                _size(0) {
+            splice_back(std::move(that));
             assert(valid());}
 
         // ----------
@@ -648,20 +1429,8 @@ class MyDeque {
          * destructor
          */
         ~MyDeque () {
-            this->clear();
-
-            if(_outer_very_begin != 0)
-                _astar.deallocate(_outer_very_begin,_outer_very_end - _outer_very_begin + 1);
-
-            _outer_begin = 0;
-            _outer_end = 0;
-            _outer_very_begin = 0;
-            _outer_very_end = 0;
-            _data_end = 0;
-            _data_begin = 0;
-            _size = 0;
-            _capacity = 0;
-            assert(valid());}
+            clear();
+            deallocate_map();}
 
         // ----------
         // operator =
@@ -669,18 +1438,29 @@ class MyDeque {
 
         /**
          * copy assignment
-         * @param that is a MyDeque by reference 
+         * @param that is a MyDeque by reference
          * @return MyDeque by reference
          */
         MyDeque& operator = (const MyDeque& that) {
             if (this == &that)
                 return *this;
             clear();
-            auto temp = const_cast<MyDeque&>(that).begin();
-            while(temp!=const_cast<MyDeque&>(that).end()){
-                push_back(*temp);
-                ++temp;}
+            for (const_iterator b = that.begin(), e = that.end(); b != e; ++b)
+                push_back(*b);
+            assert(valid());
+            return *this;}
 
+        /**
+         * move assignment; like the move constructor, takes over the rows of
+         * that when its allocator can release them, else moves the elements
+         * @param that is a MyDeque by rvalue reference
+         * @return MyDeque by reference
+         */
+        MyDeque& operator = (MyDeque&& that) {
+            if (this == &that)
+                return *this;
+            clear();
+            splice_back(std::move(that));
             assert(valid());
             return *this;}
 
@@ -694,22 +1474,15 @@ class MyDeque {
          * @return reference to value at index
          */
         reference operator [] (size_type index) {
-
-            size_type newIndex = index + (_data_begin - *_outer_begin);
-            size_type outerIndex = newIndex / INNER_SIZE;
-            size_type innerIndex = newIndex % INNER_SIZE;
-            
-            pointer* tempOuter = _outer_begin;
-            tempOuter += outerIndex;
-            pointer tempInner = *tempOuter;
-            tempInner += innerIndex;
-            return *tempInner;}
+            const size_type k = _start + index;
+            return _map._p[k / INNER_SIZE][k % INNER_SIZE];}
 
         /**
          * const variant of []
          */
         const_reference operator [] (size_type index) const {
-            return const_cast<MyDeque*>(this)->operator[](index);}
+            const size_type k = _start + index;
+            return _map._p[k / INNER_SIZE][k % INNER_SIZE];}
 
         // --
         // at
@@ -722,25 +1495,17 @@ class MyDeque {
          * @throws out_of_range exception
          */
         reference at (size_type index) {
-
-            size_type newIndex = index + (_data_begin - *_outer_begin);
-            size_type outerIndex = newIndex / INNER_SIZE;
-            size_type innerIndex = newIndex % INNER_SIZE;
-
-            if((index<0)||(index > _size - 1))
-                throw std::out_of_range("MyDeque::MyDeque()");
-            
-            pointer* tempOuter = _outer_begin;
-            tempOuter += outerIndex;
-            pointer tempInner = *tempOuter;
-            tempInner += innerIndex;
-            return *tempInner;}
+            if (index >= _size)
+                throw std::out_of_range("MyDeque::at()");
+            return (*this)[index];}
 
         /**
          * const variant of at
          */
         const_reference at (size_type index) const {
-            return const_cast<MyDeque*>(this)->at(index);}
+            if (index >= _size)
+                throw std::out_of_range("MyDeque::at()");
+            return (*this)[index];}
 
         // ----
         // back
@@ -750,13 +1515,13 @@ class MyDeque {
          * @return reference to last element
          */
         reference back () {
-            return *(_data_end - 1);}
+            return (*this)[_size - 1];}
 
         /**
          * @return const_reference to last element
          */
         const_reference back () const {
-            return const_cast<MyDeque*>(this)->back();}
+            return (*this)[_size - 1];}
 
         // -----
         // begin
@@ -766,50 +1531,43 @@ class MyDeque {
          * @return interator to first element
          */
         iterator begin () {
-            return iterator(this);}
+            return iterator_at(0);}
 
         /**
          * @return const_iterator to first element
          */
         const_iterator begin () const {
-            return const_iterator(this);}
+            return const_iterator_at(_map._p, _start);}
+
+        /**
+         * @return const_iterator to first element
+         */
+        const_iterator cbegin () const {
+            return begin();}
 
         // -----
         // clear
         // -----
 
         /**
-         * Clears deque. 
+         * Clears deque. The map is kept for reuse.
          */
         void clear () {
-            if (_capacity > 0) {
-                pointer* tempOuter = _outer_begin;
-                pointer temp = _data_begin;
-
-                if(!(_data_begin == _data_end)) {
-                    while (true) {
-                    if(temp!=_data_end)
-                        _a.destroy(temp);
-
-                    if (((*tempOuter+(INNER_SIZE - 1)) == temp)) {
-                        // std::cout<<"Deleting row"<<std::endl;
-                        _a.deallocate(*(tempOuter),INNER_SIZE);
-                        _astar.destroy(tempOuter);
-                        ++tempOuter;
-                        if(tempOuter == _outer_end)
-                            break;
-                        temp = *tempOuter;
-                    }else{
-                    ++temp;}}}
-
-                _outer_begin = _outer_very_begin; 
-                _outer_begin += ((_capacity/INNER_SIZE)/2);
-                _outer_end = _outer_begin; //This should be set when outer_resize is called
-                _data_begin = 0;
-                _data_end = 0; 
-                _size = 0;
-
-            }
+            cancel_migration(G());
+            if (_map._p) {
+                const size_type first = _start / INNER_SIZE;
+                const size_type last  = (_start + _size) / INNER_SIZE;
+                for (size_type i = first; i <= last; ++i) {
+                    pointer& row = _map._p[i];
+                    if (!row)
+                        continue;
+                    const size_type b = std::max(_start, i * INNER_SIZE) - i * INNER_SIZE;
+                    const size_type e = std::min(_start + _size, (i + 1) * INNER_SIZE) - i * INNER_SIZE;
+                    destroy(alloc(), row + b, row + std::max(b, e));
+                    deallocate_row(row);
+                    row = pointer();}
+                _start = (_map_size / 2) * INNER_SIZE + INNER_SIZE / 2;
+                _size = 0;}
             assert(valid());}
 
         // -----
@@ -830,13 +1588,19 @@ class MyDeque {
          * @return Iterator to the end of the deque.
          */
         iterator end () {
-            return iterator(this) += _size;}
+            return iterator_at(_size);}
 
         /**
          * @return Read-only iterator to the end of the deque.
          */
         const_iterator end () const {
-            return const_iterator(this) += _size;}
+            return const_iterator_at(_map._p, _start + _size);}
+
+        /**
+         * @return Read-only iterator to the end of the deque.
+         */
+        const_iterator cend () const {
+            return end();}
 
         // -----
         // erase
@@ -844,20 +1608,62 @@ class MyDeque {
 
         /**
          * Erases a value from deque given by iterator location.
+         * Whichever side of loc is shorter is shifted to close the gap.
          * @param loc Value to delete.
          * @return Iterator to next location.
          */
         iterator erase (iterator loc) {
-            auto prevIt = loc;
-            auto nextIt = ++loc;
-            auto endIt = end();
-            while(nextIt!=endIt){
-                *prevIt = *nextIt;
-                ++nextIt;
-                ++prevIt;}
-            pop_back();
+            const size_type i = loc - begin();
+            if (i < _size / 2) {
+                std::move_backward(begin(), loc, loc + 1);
+                pop_front();
+            } else {
+                std::move(loc + 1, end(), loc);
+                pop_back();}
             assert(valid());
-            return --loc;}
+            return begin() + i;}
+
+        /**
+         * Destroys the first n elements, a row at a time, releasing each row
+         * as soon as its last element goes.
+         * @param n is at most size()
+         */
+        void erase_front (size_type n) {
+            assert(n <= _size);
+            while (n) {
+                pointer& row = _map._p[_start / INNER_SIZE];
+                const size_type o   = _start % INNER_SIZE;
+                const size_type run = std::min(n, INNER_SIZE - o);
+                destroy(alloc(), row + o, row + o + run);
+                _start += run;
+                _size  -= run;
+                n      -= run;
+                if (_start % INNER_SIZE == 0) {
+                    deallocate_row(row);
+                    row = pointer();}}
+            trim_migration(G());
+            assert(valid());}
+
+        /**
+         * Destroys the last n elements, a row at a time, releasing each row
+         * as soon as its first element goes.
+         * @param n is at most size()
+         */
+        void erase_back (size_type n) {
+            assert(n <= _size);
+            while (n) {
+                const size_type e = _start + _size;
+                pointer& row = _map._p[(e - 1) / INNER_SIZE];
+                const size_type o   = (e - 1) % INNER_SIZE + 1;
+                const size_type run = std::min(n, o);
+                destroy(alloc(), row + (o - run), row + o);
+                _size -= run;
+                n     -= run;
+                if (run == o) {
+                    deallocate_row(row);
+                    row = pointer();}}
+            trim_migration(G());
+            assert(valid());}
 
         // -----
         // front
@@ -867,37 +1673,93 @@ class MyDeque {
          * @return Reference to value that is at front of deque.
          */
         reference front () {
-            return *_data_begin;}
+            return (*this)[0];}
 
         /**
          * @return Read-only Value that is at front of deque.
          */
         const_reference front () const {
-            return const_cast<MyDeque*>(this)->front();}
+            return (*this)[0];}
+
+        // -------------
+        // get_allocator
+        // -------------
+
+        /**
+         * @return a copy of the allocator
+         */
+        allocator_type get_allocator () const {
+            return _map;}
 
         // ------
         // insert
         // ------
 
         /**
-         * Inserts an element at the location of the iterator and pushes remaining elements to the back.
+         * Inserts an element at the location of the iterator.
+         * Whichever side of loc is shorter is shifted to make room.
          * @param loc Location Location to insert an element at.
          * @param val Value to insert.
          * @returns Iterator to where the value was placed.
          */
         iterator insert (iterator loc, const_reference val) {
-            auto prevIt = loc;
-            auto nextIt = ++loc;
-            auto endIt = end();
-            value_type tempVal;
-            while(nextIt!=endIt){
-                tempVal = *nextIt;
-                *nextIt = *prevIt;
-                ++nextIt;
-                ++prevIt;}
-            push_back(tempVal);
-            *(--loc) = val;
-            return iterator(loc);}
+            const size_type i = loc - begin();
+            value_type v(val);
+            if (i == 0)
+                push_front(std::move(v));
+            else if (i == _size)
+                push_back(std::move(v));
+            else {
+                if (i < _size / 2) {
+                    push_front(std::move(front()));
+                    std::move(begin() + 2, begin() + i + 1, begin() + 1);
+                } else {
+                    push_back(std::move(back()));
+                    std::move_backward(begin() + i, end() - 2, end() - 1);}
+                (*this)[i] = std::move(v);}
+            assert(valid());
+            return begin() + i;}
+
+        // ------
+        // layout
+        // ------
+
+        /**
+         * @return the map, start and size, still owned by this deque
+         */
+        layout get_layout () const {
+            layout l = {_map._p, _map_size, _start, _size};
+            return l;}
+
+        /**
+         * Gives up the map and rows without destroying or releasing anything
+         * and leaves the deque empty. The caller now owns l.
+         * @return the layout that was given up
+         */
+        layout release () {
+            static_assert(N == 0, "rows in the inline buffer can't be released");
+            cancel_migration(G());
+            const layout l = get_layout();
+            _map._p = 0;
+            _map_size = 0;
+            _start = 0;
+            _size = 0;
+            return l;}
+
+        /**
+         * Destroys the current contents and takes ownership of l, whose map
+         * and rows must have come from this deque's allocator.
+         * @param l is a layout from release() or get_layout()
+         */
+        void adopt (const layout& l) {
+            static_assert(N == 0, "rows in the inline buffer can't be adopted");
+            clear();
+            deallocate_map();
+            _map._p = l.map;
+            _map_size = l.map_size;
+            _start = l.start;
+            _size = l.size;
+            assert(valid());}
 
         // ---
         // pop
@@ -905,142 +1767,77 @@ class MyDeque {
 
         /**
          * Pops an element from the back.
+         * The row is released when its first element goes.
          */
         void pop_back () {
-            if(static_cast<size_type>(_data_end != (*(_outer_end-1)+1)))  {
-                //Not the first element in the row so just destroy it.
-                _a.destroy(_data_end-1);
-                --_data_end;
-                --_size;
-            }else{
-                //Back of data is the first element in its row, so we also have to deallocate the row it was in.
-                _a.destroy(_data_end-1);
-                --_size;
-                _a.deallocate(*_outer_end,INNER_SIZE);
-                _astar.destroy(_outer_end);
-                if(_outer_very_begin!=_outer_very_end){
-                    --_outer_end;
-                    _data_end = *_outer_end + INNER_SIZE;
-                } else {
-                    _outer_begin = _outer_very_begin; 
-                    _outer_begin += ((_capacity/INNER_SIZE)/2);
-                    _outer_end = _outer_begin; //This should be set when outer_resize is called
-                    _data_begin = 0;
-                    _data_end = 0; 
-                    _size = 0;
-                }
-            }
-
+            const size_type k = _start + --_size;
+            pointer& row = _map._p[k / INNER_SIZE];
+            traits::destroy(alloc(), row + k % INNER_SIZE);
+            if (k % INNER_SIZE == 0) {
+                deallocate_row(row);
+                row = pointer();
+                trim_migration(G());}
             assert(valid());}
 
         /**
          * Deletes an element from the front of the deque.
+         * The row is released when its last element goes.
          */
         void pop_front () {
-            if(_data_begin != *_outer_begin + INNER_SIZE-1){
-                _a.destroy(_data_begin);
-                ++_data_begin;
-                --_size;
-            }else{
-                _a.destroy(_data_begin);
-                --_size;
-                _a.deallocate(*_outer_begin, INNER_SIZE);
-                _astar.destroy(_outer_begin);
-                if (_outer_very_begin != _outer_very_end) {
-                    ++_outer_begin;
-                    _data_begin = *_outer_begin;
-                } else {
-                    //No rows left
-                    _outer_begin = _outer_very_begin; 
-                    _outer_begin += ((_capacity/INNER_SIZE)/2);
-                    _outer_end = _outer_begin; //This should be set when outer_resize is called
-                    _data_begin = 0;
-                    _data_end = 0; 
-                    _size = 0;
-                }
-            }
+            pointer& row = _map._p[_start / INNER_SIZE];
+            traits::destroy(alloc(), row + _start % INNER_SIZE);
+            ++_start;
+            --_size;
+            if (_start % INNER_SIZE == 0) {
+                deallocate_row(row);
+                row = pointer();
+                trim_migration(G());}
             assert(valid());}
 
-        //throw if unable to allocate
-        void resize_outer(bool bTop){
-            if (_capacity == 0) {
-                _outer_begin = _astar.allocate(1);
-                _astar.construct(_outer_begin);
-
-                _outer_very_end = _outer_begin;
-                _outer_very_begin = _outer_begin;
-                
-                _outer_end = _outer_begin + 1;
-
-                _data_begin = _a.allocate(INNER_SIZE);
-                
-                *_outer_begin = _data_begin;
-                _data_begin += INNER_SIZE/2;
-                _data_end = _data_begin + 1;
-                _capacity = INNER_SIZE;
-            } else if(_size == 0){
-                _astar.construct(_outer_begin);
-                _outer_end = _outer_begin + 1;
-                _data_begin = _a.allocate(INNER_SIZE);
-                *_outer_begin = _data_begin;
-                _data_begin += INNER_SIZE/2;
-                _data_end = _data_begin + 1;
-            } else {
-                //create temporary pointers for new allocation
-                pointer* new_outer_begin;
-                pointer* new_outer_end;
-                pointer* old_outer_very_begin = _outer_very_begin;
-                pointer* old_outer_very_end = _outer_very_end;
-
-                //allocate outer pointers to manage 4x old memory 
-                new_outer_begin = _astar.allocate((_capacity/INNER_SIZE) * 4);
-                
-                //Reset memory block ponters
-                _outer_very_begin = new_outer_begin;
-                _outer_very_end = _outer_very_begin + ((_capacity/INNER_SIZE) * 4) - 1; 
-
-                //center _outer_begin and _outer_end
-                new_outer_begin += (_capacity/INNER_SIZE);
-                new_outer_end = new_outer_begin;
-
-                //copy data from old block to new block
-                for(pointer* temp_pointer = _outer_begin; temp_pointer<_outer_end;++temp_pointer){
-                    _astar.construct(new_outer_end);
-                    *new_outer_end = *temp_pointer;
-                    ++new_outer_end;
-                }
-
-                //deallocate outer pointers managing the memory block
-                pointer* tempBegin = _outer_begin;
-
-                while(tempBegin!=_outer_end){
-                    _astar.destroy(tempBegin);
-                    ++tempBegin;}
-
-                _astar.deallocate(old_outer_very_begin, (old_outer_very_end - old_outer_very_begin + 1));
-                
-                //reset block pointers
-                _outer_begin = new_outer_begin;
-                _outer_end = new_outer_end;
-
-
-                if(bTop){
-                    _astar.construct(--_outer_begin);
-                    _data_begin = _a.allocate(INNER_SIZE);
-                    *_outer_begin = _data_begin;
-                    _data_begin+=(INNER_SIZE - 1);
-                } else {
-                    _astar.construct(_outer_end);
-                    _data_end = _a.allocate(INNER_SIZE);
-                    *_outer_end = _data_end;
-
-                    ++_outer_end;
-                }
-
+        /**
+         * Moves the first n elements to out, front to back, and destroys
+         * them, a row at a time.
+         * @param out is an output iterator
+         * @param n is at most size()
+         * @return out past the last element written
+         */
+        template <typename O>
+        O pop_front_n (O out, size_type n) {
+            assert(n <= _size);
+            while (n) {
+                pointer& row = _map._p[_start / INNER_SIZE];
+                const size_type o   = _start % INNER_SIZE;
+                const size_type run = std::min(n, INNER_SIZE - o);
+                out = std::move(row + o, row + o + run, out);
+                destroy(alloc(), row + o, row + o + run);
+                _start += run;
+                _size  -= run;
+                n      -= run;
+                if (_start % INNER_SIZE == 0) {
+                    deallocate_row(row);
+                    row = pointer();}}
+            trim_migration(G());
+            assert(valid());
+            return out;}
 
-                _capacity = (((_capacity/INNER_SIZE) * 4) * INNER_SIZE);
-            }
-        }
+        /**
+         * Moves the last n elements to out, in their order in the deque, and
+         * destroys them.
+         * @param out is an output iterator
+         * @param n is at most size()
+         * @return out past the last element written
+         */
+        template <typename O>
+        O pop_back_n (O out, size_type n) {
+            assert(n <= _size);
+            const size_type e = _start + _size;
+            for (size_type k = e - n; k != e; ) {
+                const size_type run = std::min(e - k, INNER_SIZE - k % INNER_SIZE);
+                pointer row = _map._p[k / INNER_SIZE];
+                out = std::move(row + k % INNER_SIZE, row + k % INNER_SIZE + run, out);
+                k += run;}
+            erase_back(n);
+            return out;}
 
         // ----
         // push
@@ -1050,80 +1847,396 @@ class MyDeque {
          * Pushes a value onto the back of the deque.
          * @param value Value you want to push onto the back of the deque.
          */
-        void push_back (const_reference value) { 
-            if (_outer_begin == _outer_end) {
-                //First time or after clear
-                resize_outer(false);
-                _a.construct(_data_begin, value);
-            } else if(static_cast<size_type>((_data_end - *(_outer_end - 1))) < INNER_SIZE) {
-                //Have room in existing row.
-                _a.construct(_data_end, value);
-                ++_data_end; 
-            }else{
-                //Need to grow.
-                if((_outer_end == (_outer_very_end + 1))) {
-                    resize_outer(false);
-                    _a.construct(_data_end, value);
-                    ++_data_end;
-                }else{
-                    _astar.construct(_outer_end);
-                    _data_end = _a.allocate(INNER_SIZE);
-                    *_outer_end = _data_end;
-                    _a.construct(_data_end,value);
-                    ++_data_end;
-                    ++_outer_end;
-                }}
-            assert(valid());
-            _size++;
-        }
+        void push_back (const_reference value) {
+            emplace_back_value(value);}
+
+        /**
+         * Moves a value onto the back of the deque.
+         */
+        void push_back (value_type&& value) {
+            emplace_back_value(std::move(value));}
 
         /**
          * Pushes a value onto the front of the deque.
          * @param value Value you want to push onto the front of the deque.
          */
         void push_front (const_reference value) {
-            if (_outer_begin == _outer_end) {
-                //First time or after clear
-                resize_outer(false);
-                _a.construct(_data_begin, value);
-            }else if(_data_begin - *_outer_begin >= 1){
-                //Have room in existing row.
-                --_data_begin;
-                _a.construct(_data_begin, value); 
-            }else{
-                //Need to grow.
-                if((_outer_begin == _outer_very_begin) && (_data_begin == *_outer_begin)) {
-                    resize_outer(true);
-                    _a.construct(_data_begin, value);
-                }else{
-                    --_outer_begin;
-                    _astar.construct(_outer_begin);
-                    _data_begin = _a.allocate(INNER_SIZE);
-                    *_outer_begin = _data_begin;
-                    _data_begin+=(INNER_SIZE-1);
-                    _a.construct(_data_begin,value);} }
-            assert(valid());
-            _size++;
-        }
+            emplace_front_value(value);}
+
+        /**
+         * Moves a value onto the front of the deque.
+         */
+        void push_front (value_type&& value) {
+            emplace_front_value(std::move(value));}
+
+        /**
+         * Copies [p, p + n) onto the back, sizing the map once and filling
+         * a row at a time.
+         * @param p is the first of n values
+         * @param n is the number of values
+         */
+        void push_back_n (const_pointer p, size_type n) {
+            grow_back(n, [this, p] (pointer d, size_type k, size_type i) {
+                uninitialized_copy(alloc(), p + i, p + i + k, d);});}
+
+        /**
+         * Copies [p, p + n) onto the front, so that p[0] becomes front(),
+         * sizing the map once and filling a row at a time.
+         * @param p is the first of n values
+         * @param n is the number of values
+         */
+        void push_front_n (const_pointer p, size_type n) {
+            grow_front(n, [this, p] (pointer d, size_type k, size_type i) {
+                uninitialized_copy(alloc(), p + i, p + i + k, d);});}
+
+    private:
+        template <typename V>
+        void emplace_back_value (V&& value) {
+            if ((_start + _size) % INNER_SIZE == 0)
+                step_migration();
+            if (!_map._p || _start + _size + 1 == _map_size * INNER_SIZE)
+                reserve_map(false);
+            const size_type k = _start + _size;
+            construct_at(_map._p[k / INNER_SIZE], k % INNER_SIZE, std::forward<V>(value));
+            ++_size;
+            assert(valid());}
+
+        template <typename V>
+        void emplace_front_value (V&& value) {
+            if (_start % INNER_SIZE == 0)
+                step_migration();
+            if (!_map._p || _start == 0)
+                reserve_map(true);
+            const size_type k = _start - 1;
+            construct_at(_map._p[k / INNER_SIZE], k % INNER_SIZE, std::forward<V>(value));
+            --_start;
+            ++_size;
+            assert(valid());}
+
+        /**
+         * Constructs n elements after the back, a row at a time: make(d, k, i)
+         * constructs k elements at d, the ith to kth of the n. A row
+         * allocated for a call that throws is released again.
+         */
+        template <typename F>
+        void grow_back (size_type n, F make) {
+            if (!n)
+                return;
+            step_migration(n / INNER_SIZE + 1);
+            if (!_map._p)
+                reserve_map(false);
+            const size_type e    = _start + _size;
+            const size_type rows = (e + n) / INNER_SIZE - e / INNER_SIZE;
+            if (e / INNER_SIZE + rows >= _map_size)
+                reserve_map(false, rows);
+            for (size_type i = 0; i != n; ) {
+                const size_type k = _start + _size;
+                pointer& row = _map._p[k / INNER_SIZE];
+                const size_type o   = k % INNER_SIZE;
+                const size_type run = std::min(n - i, INNER_SIZE - o);
+                const bool fresh = !row;
+                if (fresh)
+                    row = allocate_row();
+                try {
+                    make(row + o, run, i);}
+                catch (...) {
+                    if (fresh) {
+                        deallocate_row(row);
+                        row = pointer();}
+                    throw;}
+                _size += run;
+                i     += run;}
+            assert(valid());}
+
+        /**
+         * Constructs n elements before the front, a row at a time from the
+         * back: make(d, k, i) constructs k elements at d, the ith to kth of
+         * the n counted from the new front.
+         */
+        template <typename F>
+        void grow_front (size_type n, F make) {
+            if (!n)
+                return;
+            step_migration(n / INNER_SIZE + 1);
+            if (!_map._p)
+                reserve_map(true);
+            if (_start < n)
+                reserve_map(true, (n - _start % INNER_SIZE + INNER_SIZE - 1) / INNER_SIZE);
+            for (size_type left = n; left; ) {
+                pointer& row = _map._p[(_start - 1) / INNER_SIZE];
+                const size_type o   = (_start - 1) % INNER_SIZE + 1;
+                const size_type run = std::min(left, o);
+                const bool fresh = !row;
+                if (fresh)
+                    row = allocate_row();
+                try {
+                    make(row + (o - run), run, left - run);}
+                catch (...) {
+                    if (fresh) {
+                        deallocate_row(row);
+                        row = pointer();}
+                    throw;}
+                _start -= run;
+                _size  += run;
+                left   -= run;}
+            assert(valid());}
+
+        /**
+         * Replaces the contents with n elements whose bytes the caller fills
+         * in, laid out from the start of a row so that every row but the last
+         * is full. Only for trivially copyable value types. If an allocation
+         * throws, the deque is left empty.
+         * @param n is the number of elements, at most max_size()
+         */
+        void assign_raw (size_type n) {
+            assert(n <= max_size());
+            clear();
+            if (!n)
+                return;
+            const size_type rows  = (n + INNER_SIZE - 1) / INNER_SIZE;
+            const size_type slots = rows + 2;
+            if (_map_size < slots) {
+                deallocate_map();
+                _map._p   = 0;
+                _map_size = 0;
+                _start    = 0;
+                if (_map.inline_slots() >= slots)
+                    reserve_map(false);
+                else {
+                    const size_type k = std::max(INITIAL_SLOTS, slots);
+                    _map._p   = allocate_map(k);
+                    _map_size = k;}}
+            _start = INNER_SIZE;
+            try {
+                for (size_type i = 1; i <= rows; ++i) {
+                    _map._p[i] = allocate_row();
+                    _size = std::min(n, i * INNER_SIZE);}}
+            catch (...) {
+                clear();
+                throw;}
+            assert(valid());}
+
+        /**
+         * @return the header describing this deque
+         */
+        deque_header header () const {
+            deque_header h;
+            std::memcpy(h.magic, "MYDQ", 4);
+            h.value_size = sizeof(value_type);
+            h.size = _size;
+            return h;}
+
+        /**
+         * Constructs value at offset i of row, allocating the row if the slot
+         * is empty. A freshly allocated row is released again if the
+         * construction throws.
+         */
+        template <typename V>
+        void construct_at (pointer& row, size_type i, V&& value) {
+            if (row) {
+                traits::construct(alloc(), row + i, std::forward<V>(value));
+                return;}
+            pointer p = allocate_row();
+            try {
+                traits::construct(alloc(), p + i, std::forward<V>(value));}
+            catch (...) {
+                deallocate_row(p);
+                throw;}
+            row = p;}
+
+    public:
+        // -----------
+        // rbegin/rend
+        // -----------
+
+        /**
+         * @return reverse_iterator to the last element
+         */
+        reverse_iterator rbegin () {
+            return reverse_iterator(end());}
+
+        /**
+         * @return const_reverse_iterator to the last element
+         */
+        const_reverse_iterator rbegin () const {
+            return const_reverse_iterator(end());}
+
+        /**
+         * @return reverse_iterator past the first element
+         */
+        reverse_iterator rend () {
+            return reverse_iterator(begin());}
+
+        /**
+         * @return const_reverse_iterator past the first element
+         */
+        const_reverse_iterator rend () const {
+            return const_reverse_iterator(begin());}
+
+        const_reverse_iterator crbegin () const {
+            return rbegin();}
+
+        const_reverse_iterator crend () const {
+            return rend();}
 
         // ------
         // resize
         // ------
 
         /**
-         * Resizes the container so that it contains n elements.
+         * Resizes the container so that it contains n elements, erasing or
+         * filling a row at a time.
          * @param s Size you want to resize to
          * @param v Optional value to fill new space with.
          */
         void resize (size_type s, const_reference v = value_type()) {
-            while (_size > s) {
-                pop_back();
-            }
-            while (_size != s) {
-                push_back(v);
-            }
+            if (s < _size)
+                erase_back(_size - s);
+            else
+                grow_back(s - _size, [this, &v] (pointer d, size_type k, size_type) {
+                    uninitialized_fill(alloc(), d, d + k, v);});
             assert(valid());}
 
+        // ----
+        // save
+        // ----
+
+        /**
+         * Writes a deque_header and then the elements, one write per row.
+         * Errors are reported through the state of os.
+         * @param os is the stream to write to
+         */
+        void save (std::ostream& os) const {
+            static_assert(std::is_trivially_copyable<value_type>::value, "save() needs a trivially copyable value_type");
+            const deque_header h = header();
+            os.write(reinterpret_cast<const char*>(&h), sizeof(h));
+            for_each_segment([&os] (const_pointer p, size_type n) {
+                os.write(reinterpret_cast<const char*>(&*p), n * sizeof(value_type));});}
+
+        // --------
+        // write_to
+        // --------
+
+        /**
+         * Writes the same bytes as save() to fd, gathering up to IOV_BATCH
+         * rows into each writev call.
+         * @param fd is a file descriptor open for writing
+         * @throws system_error if a write fails
+         */
+        void write_to (int fd) const {
+            static_assert(std::is_trivially_copyable<value_type>::value, "write_to() needs a trivially copyable value_type");
+            deque_header h = header();
+            iovec iov[IOV_BATCH];
+            int n = 0;
+            iov[n].iov_base = &h;
+            iov[n++].iov_len = sizeof(h);
+            for_each_segment([&] (const_pointer p, size_type k) {
+                if (n == IOV_BATCH) {
+                    deque_write_all(fd, iov, n);
+                    n = 0;}
+                iov[n].iov_base = const_cast<value_type*>(&*p);
+                iov[n++].iov_len = k * sizeof(value_type);});
+            deque_write_all(fd, iov, n);}
+
+        // ----
+        // load
+        // ----
+
+        /**
+         * Replaces the contents with what save() wrote, sizing the map once
+         * and reading straight into freshly allocated rows.
+         * On a bad header, a size more than max_size() or than can be
+         * allocated, or a short read the deque is left empty and failbit is
+         * set on is.
+         * @param is is the stream to read from
+         */
+        void load (std::istream& is) {
+            static_assert(std::is_trivially_copyable<value_type>::value, "load() needs a trivially copyable value_type");
+            clear();
+            deque_header h;
+            if (!is.read(reinterpret_cast<char*>(&h), sizeof(h)))
+                return;
+            if (!h.matches(sizeof(value_type)) || h.size > max_size()) {
+                is.setstate(std::ios_base::failbit);
+                return;}
+            try {
+                assign_raw(h.size);}
+            catch (const std::bad_alloc&) {
+                is.setstate(std::ios_base::failbit);
+                return;}
+            for_each_segment([&is] (const_pointer p, size_type n) {
+                is.read(reinterpret_cast<char*>(const_cast<value_type*>(&*p)), n * sizeof(value_type));});
+            if (!is)
+                clear();}
+
+        // ---------
+        // read_from
+        // ---------
+
+        /**
+         * Replaces the contents with what write_to() wrote, scattering up to
+         * IOV_BATCH rows into each readv call.
+         * @param fd is a file descriptor open for reading
+         * @throws system_error if a read fails, runtime_error on a bad header,
+         * including a size more than max_size() or than what is left of a
+         * regular file, or end of file; the deque is left empty
+         */
+        void read_from (int fd) {
+            static_assert(std::is_trivially_copyable<value_type>::value, "read_from() needs a trivially copyable value_type");
+            clear();
+            deque_header h;
+            iovec iov[IOV_BATCH];
+            iov[0].iov_base = &h;
+            iov[0].iov_len = sizeof(h);
+            deque_read_all(fd, iov, 1);
+            if (!h.matches(sizeof(value_type)) || h.size > max_size())
+                throw std::runtime_error("MyDeque::read_from(): bad header");
+            struct stat st;
+            if (!::fstat(fd, &st) && S_ISREG(st.st_mode)) {
+                const off_t at = ::lseek(fd, 0, SEEK_CUR);
+                if (at >= 0 && h.size > (static_cast<std::uint64_t>(st.st_size) - std::min<std::uint64_t>(at, st.st_size)) / sizeof(value_type))
+                    throw std::runtime_error("MyDeque::read_from(): bad header");}
+            assign_raw(h.size);
+            try {
+                int n = 0;
+                for_each_segment([&] (const_pointer p, size_type k) {
+                    if (n == IOV_BATCH) {
+                        deque_read_all(fd, iov, n);
+                        n = 0;}
+                    iov[n].iov_base = const_cast<value_type*>(&*p);
+                    iov[n++].iov_len = k * sizeof(value_type);});
+                deque_read_all(fd, iov, n);}
+            catch (...) {
+                clear();
+                throw;}}
+
+        // ----------------
+        // for_each_segment
+        // ----------------
+
+        /**
+         * Calls f(p, n) for each run of n contiguous elements starting at p,
+         * front to back; see const_slice::for_each_segment().
+         * @param f is a function object taking (const_pointer, size_type)
+         * @param ahead is the prefetch distance in rows, 0 for none -- defaulted
+         */
+        template <typename F>
+        void for_each_segment (F f, size_type ahead = PREFETCH_ROWS) const {
+            const_slice(*this).for_each_segment(f, ahead);}
+
+        // --------
+        // max_size
+        // --------
+
+        /**
+         * @return the most elements the deque can hold: what the allocator
+         * can allocate, and never so many that their bytes or a count of
+         * rows rounded up overflows
+         */
+        size_type max_size () const {
+            const size_type n = static_cast<size_type>(std::numeric_limits<std::ptrdiff_t>::max()) / sizeof(value_type);
+            return std::min(n, static_cast<size_type>(traits::max_size(static_cast<const allocator_type&>(_map))));}
+
         // ----
         // size
         // ----
@@ -1134,20 +2247,260 @@ class MyDeque {
         size_type size () const {
             return _size;}
 
+        // -----
+        // slice
+        // -----
+
+        /**
+         * @param first is an index in [0, size()]
+         * @param last is an index in [first, size()]
+         * @return a const_slice of [first, last), made in O(1)
+         */
+        const_slice slice (size_type first, size_type last) const {
+            assert(first <= last && last <= _size);
+            return const_slice(_map._p, _start + first, last - first);}
+
+        // ------
+        // splice
+        // ------
+
+        /**
+         * Appends the elements of that and leaves it empty.
+         * When the element after this deque's back and that's front fall at
+         * the same offset within a row, that's rows are handed over as they
+         * are: at most INNER_SIZE - 1 elements are moved to fill the seam row
+         * and the rest costs one pointer copy per row. Otherwise the shorter
+         * of the two deques is moved element by element into the other.
+         * Rows only change hands when the allocators compare equal and there
+         * is no inline storage; else every element of that is moved.
+         * @param that is a MyDeque by rvalue reference
+         */
+        void splice_back (MyDeque&& that) {
+            if (this == &that || that.empty())
+                return;
+            if (!can_take_rows(that)) {
+                while (!that.empty()) {
+                    push_back(std::move(that.front()));
+                    that.pop_front();}
+                return;}
+            if (empty()) {
+                swap(that);
+                return;}
+            if ((_start + _size) % INNER_SIZE != that._start % INNER_SIZE) {
+                if (that._size <= _size)
+                    while (!that.empty()) {
+                        push_back(std::move(that.front()));
+                        that.pop_front();}
+                else {
+                    while (!empty()) {
+                        that.push_front(std::move(back()));
+                        pop_back();}
+                    swap(that);}
+                return;}
+            while (!that.empty() && (_start + _size) % INNER_SIZE) {
+                push_back(std::move(that.front()));
+                that.pop_front();}
+            if (that.empty())
+                return;
+            const size_type rows = (that._size + INNER_SIZE - 1) / INNER_SIZE;
+            if ((_start + _size) / INNER_SIZE + rows >= _map_size)
+                reserve_map(false, rows);
+            take_rows(that, (_start + _size) / INNER_SIZE, rows);
+            _size += that._size;
+            that._size = 0;
+            that.clear();
+            assert(valid());}
+
+        /**
+         * Prepends the elements of that and leaves it empty, handing rows
+         * over under the same conditions as splice_back().
+         * @param that is a MyDeque by rvalue reference
+         */
+        void splice_front (MyDeque&& that) {
+            if (this == &that || that.empty())
+                return;
+            if (!can_take_rows(that)) {
+                while (!that.empty()) {
+                    push_front(std::move(that.back()));
+                    that.pop_back();}
+                return;}
+            if (empty()) {
+                swap(that);
+                return;}
+            if ((that._start + that._size) % INNER_SIZE != _start % INNER_SIZE) {
+                if (that._size <= _size)
+                    while (!that.empty()) {
+                        push_front(std::move(that.back()));
+                        that.pop_back();}
+                else {
+                    while (!empty()) {
+                        that.push_back(std::move(front()));
+                        pop_front();}
+                    swap(that);}
+                return;}
+            while (!that.empty() && _start % INNER_SIZE) {
+                push_front(std::move(that.back()));
+                that.pop_back();}
+            if (that.empty())
+                return;
+            const size_type rows = (that._start + that._size) / INNER_SIZE - that._start / INNER_SIZE;
+            if (_start / INNER_SIZE < rows)
+                reserve_map(true, rows);
+            take_rows(that, _start / INNER_SIZE - rows, rows);
+            _start -= that._size;
+            _size += that._size;
+            that._size = 0;
+            that.clear();
+            assert(valid());}
+
+        // --------
+        // split_at
+        // --------
+
+        /**
+         * Cuts the deque in two at pos: this deque keeps [begin(), pos) and
+         * the returned one gets [pos, end()). The rows after the one holding
+         * *pos change hands as they are; only the elements of that row from
+         * pos on are moved, into a new row at the same offsets. With inline
+         * storage every element after pos is moved instead.
+         * @param pos is an iterator into this deque
+         * @return a MyDeque holding [pos, end())
+         */
+        MyDeque split_at (iterator pos) {
+            const size_type i = pos - begin();
+            cancel_migration(G());
+            MyDeque that(alloc());
+            if (i == _size)
+                return that;
+            if (INLINE_ROWS) {
+                for (iterator b = pos, e = end(); b != e; ++b)
+                    that.push_back(std::move(*b));
+                while (_size != i)
+                    pop_back();
+                return that;}
+            if (!i) {
+                swap(that);
+                return that;}
+            const size_type k     = _start + i;
+            const size_type first = k / INNER_SIZE;
+            const size_type rows  = (_start + _size - 1) / INNER_SIZE - first + 1;
+            that._map_size = std::max(INITIAL_SLOTS, 2 * rows + 2);
+            that._map._p   = that.allocate_map(that._map_size);
+            const size_type f = (that._map_size - rows) / 2;
+            pointer& row = _map._p[first];
+            const size_type o = k % INNER_SIZE;
+            if (o) {
+                const size_type e = std::min(INNER_SIZE, o + _size - i);
+                pointer p = that.allocate_row();
+                try {
+                    uninitialized_copy(alloc(), std::make_move_iterator(row + o), std::make_move_iterator(row + e), p + o);}
+                catch (...) {
+                    that.deallocate_row(p);
+                    throw;}
+                destroy(alloc(), row + o, row + e);
+                that._map._p[f] = p;
+            } else {
+                that._map._p[f] = row;
+                row = pointer();}
+            std::copy(_map._p + first + 1, _map._p + first + rows, that._map._p + f + 1);
+            std::fill(_map._p + first + 1, _map._p + first + rows, pointer());
+            that._start = f * INNER_SIZE + o;
+            that._size  = _size - i;
+            _size = i;
+            assert(valid());
+            assert(that.valid());
+            return that;}
+
+    private:
+        /**
+         * @return true if rows allocated by that can be released by this deque
+         */
+        bool can_take_rows (const MyDeque& that) const {
+            return !INLINE_ROWS && static_cast<const allocator_type&>(_map) == static_cast<const allocator_type&>(that._map);}
+
+        /**
+         * Moves that's rows, starting with the one holding its front, into
+         * the slots [i, i + rows) of this map, leaving null slots behind.
+         */
+        void take_rows (MyDeque& that, size_type i, size_type rows) {
+            pointer* const from = that._map._p + that._start / INNER_SIZE;
+            std::copy(from, from + rows, _map._p + i);
+            std::fill(from, from + rows, pointer());}
+
+        /**
+         * @return true if neither the map nor any row is inline storage, so
+         * that the map can change hands
+         */
+        bool spilled () {
+            return _map._p != _map.inline_map() && !_map.rows_in_use();}
+
+        /**
+         * Destroys the elements and releases the rows and the map, leaving
+         * the deque as a default constructed one.
+         */
+        void reset () {
+            clear();
+            deallocate_map();
+            _map._p   = 0;
+            _map_size = 0;
+            _start    = 0;}
+
+    public:
         // ----
         // swap
         // ----
 
         /**
-         * Exchanges the content of the container by the content of x, 
+         * Exchanges the content of the container by the content of x,
          * which is another deque object containing elements of the same type. Sizes may differ.
-         * 
+         * Without inline storage, or once both deques have spilled out of it,
+         * this only exchanges the maps and the allocators. Otherwise the
+         * elements are moved, each into rows of the allocator it ends up with.
          */
         void swap (MyDeque& that) {
-            MyDeque temp;
-            temp = *this;
-            *this = that;
-            that = temp;
+            if (this == &that)
+                return;
+            cancel_migration(G());
+            that.cancel_migration(G());
+            using std::swap;
+            if (INLINE_ROWS && !(spilled() && that.spilled())) {
+                MyDeque a(std::move(*this));
+                MyDeque b(std::move(that));
+                reset();
+                that.reset();
+                swap(alloc(), that.alloc());
+                splice_back(std::move(b));
+                that.splice_back(std::move(a));
+            } else {
+                swap(alloc(), that.alloc());
+                swap(_map._p, that._map._p);
+                swap(_map_size, that._map_size);
+                swap(_start, that._start);
+                swap(_size, that._size);}
             assert(valid());}};
 
+template <typename T, typename A, std::size_t N, typename G>
+const typename MyDeque<T, A, N, G>::size_type MyDeque<T, A, N, G>::INNER_SIZE;
+
+template <typename T, typename A, std::size_t N, typename G>
+const typename MyDeque<T, A, N, G>::size_type MyDeque<T, A, N, G>::INITIAL_SLOTS;
+
+template <typename T, typename A, std::size_t N, typename G>
+const typename MyDeque<T, A, N, G>::size_type MyDeque<T, A, N, G>::INLINE_ROWS;
+
+template <typename T, typename A, std::size_t N, typename G>
+const int MyDeque<T, A, N, G>::IOV_BATCH;
+
+template <typename T, typename A, std::size_t N, typename G>
+const typename MyDeque<T, A, N, G>::size_type MyDeque<T, A, N, G>::PREFETCH_ROWS;
+
+template <typename T, typename A, std::size_t N, typename G>
+const typename MyDeque<T, A, N, G>::size_type MyDeque<T, A, N, G>::MIGRATE_COPY_SLOTS;
+
+template <typename T, typename A, std::size_t N, typename G>
+const typename MyDeque<T, A, N, G>::size_type MyDeque<T, A, N, G>::MIGRATE_CLEAR_SLOTS;
+
+template <typename T, typename A, std::size_t N, typename G>
+const typename MyDeque<T, A, N, G>::size_type MyDeque<T, A, N, G>::MIGRATE_MIN_ROWS;
+
 #endif // Deque_h
@@ -0,0 +1,193 @@
+// ---------------------------
+// projects/deque/DequeSort.h
+// ---------------------------
+
+#ifndef DequeSort_h
+#define DequeSort_h
+
+// --------
+// includes
+// --------
+
+#include <algorithm>   // max_element, min, sort, stable_sort
+#include <cstddef>     // size_t
+#include <cstdint>     // uint32_t, uint64_t
+#include <cstring>     // memcpy
+#include <functional>  // less
+#include <iterator>    // back_inserter
+#include <type_traits> // conditional, decay, is_floating_point, is_signed, make_unsigned
+#include <utility>     // declval, move
+#include <vector>      // vector
+
+#include "Deque.h"
+
+// ---------------
+// deque_radix_key
+// ---------------
+
+/**
+ * Maps an integer or floating point key to an unsigned integer of the same
+ * size in the same order, for radix sorting: signed integers have their sign
+ * bit flipped, negative floats all their bits and other floats the sign bit.
+ */
+template <typename K, bool F = std::is_floating_point<K>::value>
+struct deque_radix_key {
+    typedef typename std::make_unsigned<K>::type type;
+
+    static type bits (K k) {
+        type u = static_cast<type>(k);
+        if (std::is_signed<K>::value)
+            u ^= type(1) << (sizeof(type) * 8 - 1);
+        return u;}};
+
+template <typename K>
+struct deque_radix_key<K, true> {
+    static_assert(sizeof(K) == 4 || sizeof(K) == 8, "only float and double keys");
+
+    typedef typename std::conditional<sizeof(K) == 4, std::uint32_t, std::uint64_t>::type type;
+
+    static type bits (K k) {
+        type u;
+        std::memcpy(&u, &k, sizeof(u));
+        const type sign = type(1) << (sizeof(type) * 8 - 1);
+        return (u & sign) ? ~u : (u | sign);}};
+
+// ----------------
+// deque_sort_merge
+// ----------------
+
+/**
+ * Merges the sorted deques a and b into out, taking from a on ties. Each
+ * element is moved once; a and b give their rows back as they drain and out
+ * takes new ones as it fills, so the merge holds a few rows more than its
+ * input, never a second copy of it.
+ */
+template <typename D, typename Compare>
+void deque_sort_merge (D& a, D& b, D& out, Compare c) {
+    while (!a.empty() && !b.empty())
+        if (c(b.front(), a.front())) {
+            out.push_back(std::move(b.front()));
+            b.pop_front();}
+        else {
+            out.push_back(std::move(a.front()));
+            a.pop_front();}
+    out.splice_back(std::move(a));
+    out.splice_back(std::move(b));}
+
+// ---------------
+// deque_sort_runs
+// ---------------
+
+/**
+ * Cuts d into runs of at most R elements, sorts each with sort(b, e, c),
+ * and merges neighbouring runs in rounds until one is left, which is
+ * swapped back into d. The runs are cut from the back with split_at(), which
+ * hands rows over rather than copying them, and a drained run releases its
+ * map at once.
+ */
+template <typename D, typename Compare, typename Sort>
+void deque_sort_runs (D& d, Compare c, Sort sort) {
+    const typename D::size_type R = 1 << 16;
+    if (d.size() <= R) {
+        sort(d.begin(), d.end(), c);
+        return;}
+    MyDeque<D> runs;
+    while (!d.empty()) {
+        const typename D::size_type k = std::min(R, d.size());
+        sort(d.end() - k, d.end(), c);
+        runs.push_front(d.split_at(d.end() - k));}
+    while (runs.size() > 1) {
+        MyDeque<D> next;
+        for (typename MyDeque<D>::size_type i = 0; i + 1 < runs.size(); i += 2) {
+            D out(d.get_allocator());
+            deque_sort_merge(runs[i], runs[i + 1], out, c);
+            D(d.get_allocator()).swap(runs[i]);
+            D(d.get_allocator()).swap(runs[i + 1]);
+            next.push_back(std::move(out));}
+        if (runs.size() % 2)
+            next.push_back(std::move(runs.back()));
+        runs.swap(next);}
+    d.swap(runs.front());}
+
+// ----------
+// deque_sort
+// ----------
+
+/**
+ * Sorts d in place by c. MyDeque's iterators are random access, so this is
+ * std::sort over them: introsort swaps elements where they lie and needs no
+ * memory beyond its stack, which a run-and-merge sort cannot beat.
+ */
+template <typename T, typename A, std::size_t N, typename G, typename Compare>
+void deque_sort (MyDeque<T, A, N, G>& d, Compare c) {
+    std::sort(d.begin(), d.end(), c);}
+
+template <typename T, typename A, std::size_t N, typename G>
+void deque_sort (MyDeque<T, A, N, G>& d) {
+    deque_sort(d, std::less<T>());}
+
+// -----------------
+// deque_stable_sort
+// -----------------
+
+/**
+ * Sorts d in place by c, keeping equal elements in order. std::stable_sort
+ * over the whole deque asks for a buffer half as large as d; here runs of
+ * 1 << 16 elements are stable sorted one at a time and then merged row by
+ * row (see deque_sort_merge), so the buffer stays the size of one run.
+ */
+template <typename T, typename A, std::size_t N, typename G, typename Compare>
+void deque_stable_sort (MyDeque<T, A, N, G>& d, Compare c) {
+    deque_sort_runs(d, c, [] (typename MyDeque<T, A, N, G>::iterator b, typename MyDeque<T, A, N, G>::iterator e, Compare c) {
+        std::stable_sort(b, e, c);});}
+
+template <typename T, typename A, std::size_t N, typename G>
+void deque_stable_sort (MyDeque<T, A, N, G>& d) {
+    deque_stable_sort(d, std::less<T>());}
+
+// ----------------
+// deque_radix_sort
+// ----------------
+
+/**
+ * Sorts d in place by key(element), an integer or floating point value,
+ * keeping equal keys in order. This is an LSD radix sort a byte per pass:
+ * each pass streams d's elements into 256 bucket deques, freeing d's rows as
+ * it goes, and splices the buckets back together. One pass over d first
+ * counts every byte of every key, and passes whose byte is the same for all
+ * keys are skipped.
+ * @param key is a function object taking a const T& -- defaulted to the element
+ */
+template <typename T, typename A, std::size_t N, typename G, typename Key>
+void deque_radix_sort (MyDeque<T, A, N, G>& d, Key key) {
+    typedef MyDeque<T, A, N, G>                                             deque_type;
+    typedef typename std::decay<decltype(key(std::declval<const T&>()))>::type key_type;
+    typedef deque_radix_key<key_type>                                        radix;
+    typedef typename radix::type                                             bits_type;
+    const std::size_t B = sizeof(bits_type);
+
+    std::vector<std::size_t> counts(B * 256, 0);
+    d.for_each_segment([&] (typename deque_type::const_pointer p, typename deque_type::size_type n) {
+        for (typename deque_type::size_type i = 0; i != n; ++i) {
+            const bits_type u = radix::bits(key(p[i]));
+            for (std::size_t j = 0; j != B; ++j)
+                ++counts[j * 256 + ((u >> (8 * j)) & 0xff)];}});
+
+    std::vector<T> chunk;
+    for (std::size_t j = 0; j != B; ++j) {
+        if (d.empty() || *std::max_element(counts.begin() + j * 256, counts.begin() + (j + 1) * 256) == d.size())
+            continue;
+        std::vector<deque_type> buckets(256, deque_type(d.get_allocator()));
+        while (!d.empty()) {
+            chunk.clear();
+            d.pop_front_n(std::back_inserter(chunk), std::min<typename deque_type::size_type>(d.size(), 1024));
+            for (typename std::vector<T>::iterator b = chunk.begin(); b != chunk.end(); ++b)
+                buckets[(radix::bits(key(*b)) >> (8 * j)) & 0xff].push_back(std::move(*b));}
+        for (std::size_t i = 0; i != 256; ++i)
+            d.splice_back(std::move(buckets[i]));}}
+
+template <typename T, typename A, std::size_t N, typename G>
+void deque_radix_sort (MyDeque<T, A, N, G>& d) {
+    deque_radix_sort(d, [] (const T& v) -> const T& {return v;});}
+
+#endif // DequeSort_h
@@ -0,0 +1,538 @@
+// ----------------------------
+// projects/deque/MappedDeque.h
+// ----------------------------
+
+#ifndef MappedDeque_h
+#define MappedDeque_h
+
+// --------
+// includes
+// --------
+
+#include <algorithm>    // max, min
+#include <cerrno>       // errno
+#include <cstddef>      // size_t
+#include <cstdint>      // uint64_t, uintptr_t
+#include <cstring>      // memcmp, memcpy, memset
+#include <new>          // bad_alloc
+#include <stdexcept>    // runtime_error
+#include <string>       // string
+#include <system_error> // system_error
+#include <type_traits>  // is_trivially_copyable
+
+#include <fcntl.h>      // fallocate, open, FALLOC_FL_*
+#include <sys/mman.h>   // mmap, msync, munmap
+#include <sys/stat.h>   // fstat
+#include <unistd.h>     // close, ftruncate
+
+#include "Deque.h"
+
+// ----------------
+// deque_file_arena
+// ----------------
+
+/**
+ * A file mapped MAP_SHARED into a fixed reservation of address space, carved
+ * into chunks for a MappedFileAllocator. The first page is a header that
+ * holds the bump pointer, one free list per chunk size and the layout of the
+ * deque stored in the file. Freed chunks are recycled through the free lists.
+ * Chunks smaller than a page link to the next free one from their first word.
+ * Chunks of a page or more are whole, page aligned pages, and their free list
+ * is a chain of trunks: a trunk is a free chunk whose first page lists up to
+ * TRUNK_SLOTS other free chunks, which are punched out of the file entirely,
+ * as is everything in the trunk past its first page. So a freed row gives its
+ * disk blocks back at once, at the cost of one page per TRUNK_SLOTS rows.
+ * Offsets rather than pointers are kept in the file, so it can be mapped at a
+ * different address next time.
+ */
+class deque_file_arena {
+    public:
+        //Size of the header, and the granularity of hole punching.
+        const static std::size_t PAGE = 4096;
+
+        //Every chunk starts on a cache line.
+        const static std::size_t ALIGN = 64;
+
+        //Number of distinct chunk sizes with a free list.
+        const static std::size_t CLASSES = 64;
+
+        //Free chunks a trunk lists, after its next trunk and its count.
+        const static std::size_t TRUNK_SLOTS = PAGE / sizeof(std::uint64_t) - 2;
+
+        /**
+         * The first page of the file.
+         */
+        struct header {
+            char          magic[8];            // "MYDQMAP2"
+            std::uint64_t value_size;          // sizeof(value_type)
+            std::uint64_t top;                 // end of the highest chunk ever handed out
+            std::uint64_t bytes[CLASSES];      // chunk size of each free list, 0 for unused
+            std::uint64_t head[CLASSES];       // offset of the first free chunk or trunk, 0 for none
+            std::uint64_t base;                // address the file was mapped at when the layout was saved
+            std::uint64_t map;                 // offset of the deque's map, 0 for none
+            std::uint64_t map_size;
+            std::uint64_t start;
+            std::uint64_t size;};
+
+    private:
+        // ----
+        // data
+        // ----
+
+        int         _fd;
+        char*       _base;
+        std::size_t _reserve;   // bytes of address space mapped
+        std::size_t _file_size;
+
+    private:
+        /**
+         * @throws system_error for errno
+         */
+        static void fail (const char* what) {
+            throw std::system_error(errno, std::generic_category(), what);}
+
+        header& head () {
+            return *reinterpret_cast<header*>(_base);}
+
+        /**
+         * @return the size of the chunk allocate(n) hands out: n rounded up to
+         * a cache line, or to whole pages once that is a page or more
+         */
+        static std::uint64_t chunk_bytes (std::size_t n) {
+            const std::uint64_t b = (n + ALIGN - 1) / ALIGN * ALIGN;
+            return (b < PAGE) ? b : (b + PAGE - 1) / PAGE * PAGE;}
+
+        /**
+         * Punches the n bytes at off, a multiple of PAGE, out of the file.
+         */
+        void punch (std::uint64_t off, std::uint64_t n) {
+            if (n)
+                ::fallocate(_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, off, n);}
+
+        /**
+         * @return the free list for chunks of b bytes, or CLASSES if there is no room for one
+         */
+        std::size_t size_class (std::uint64_t b) {
+            header& h = head();
+            for (std::size_t i = 0; i != CLASSES; ++i)
+                if (h.bytes[i] == b || !h.bytes[i]) {
+                    h.bytes[i] = b;
+                    return i;}
+            return CLASSES;}
+
+        /**
+         * Grows the file so that it is at least n bytes long.
+         */
+        void grow (std::size_t n) {
+            if (n <= _file_size)
+                return;
+            std::size_t s = std::max(n, std::min(_file_size * 2, _file_size + (std::size_t(1) << 30)));
+            s = (s + PAGE - 1) / PAGE * PAGE;
+            if (s > _reserve)
+                throw std::bad_alloc();
+            if (::ftruncate(_fd, s))
+                fail("deque_file_arena::grow()");
+            _file_size = s;}
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        /**
+         * Opens path, creating it if it does not exist.
+         * @param path is the file to map
+         * @param value_size is sizeof(value_type) of the deque stored in the file
+         * @param reserve is the most the file can grow to
+         * @throws system_error, or runtime_error if the file holds something else
+         */
+        deque_file_arena (const std::string& path, std::size_t value_size, std::size_t reserve) :
+                _fd(-1),
+                _base(0),
+                _reserve(reserve),
+                _file_size(0) {
+            _fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+            if (_fd < 0)
+                fail("deque_file_arena::deque_file_arena()");
+            struct stat st;
+            if (::fstat(_fd, &st) || (!st.st_size && ::ftruncate(_fd, PAGE))) {
+                ::close(_fd);
+                fail("deque_file_arena::deque_file_arena()");}
+            const bool fresh = !st.st_size;
+            _file_size = fresh ? PAGE : st.st_size;
+            void* p = (_file_size <= _reserve) ? ::mmap(0, _reserve, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_NORESERVE, _fd, 0) : MAP_FAILED;
+            if (p == MAP_FAILED) {
+                ::close(_fd);
+                fail("deque_file_arena::deque_file_arena()");}
+            _base = static_cast<char*>(p);
+            header& h = head();
+            if (fresh) {
+                std::memset(&h, 0, sizeof(h));
+                std::memcpy(h.magic, "MYDQMAP2", 8);
+                h.value_size = value_size;
+                h.top = PAGE;}
+            else if (std::memcmp(h.magic, "MYDQMAP2", 8) || h.value_size != value_size) {
+                ::munmap(_base, _reserve);
+                ::close(_fd);
+                throw std::runtime_error("deque_file_arena::deque_file_arena(): not a deque of this type");}}
+
+        deque_file_arena (const deque_file_arena&) = delete;
+        deque_file_arena& operator = (const deque_file_arena&) = delete;
+
+        // ----------
+        // destructor
+        // ----------
+
+        /**
+         * Unmaps and closes the file without syncing it; call flush() first.
+         */
+        ~deque_file_arena () {
+            ::munmap(_base, _reserve);
+            ::close(_fd);}
+
+        // --------
+        // allocate
+        // --------
+
+        /**
+         * @param n is a number of bytes
+         * @return a chunk of at least n bytes in the file, recycled if possible
+         * @throws bad_alloc once the file would outgrow the reservation
+         */
+        void* allocate (std::size_t n) {
+            const std::uint64_t b = chunk_bytes(n);
+            header& h = head();
+            const std::size_t c = size_class(b);
+            if (c != CLASSES && h.head[c]) {
+                char* p = _base + h.head[c];
+                if (b < PAGE) {
+                    std::memcpy(&h.head[c], p, sizeof(std::uint64_t));
+                    return p;}
+                std::uint64_t* t = reinterpret_cast<std::uint64_t*>(p);
+                if (t[1])
+                    return _base + t[2 + --t[1]];
+                h.head[c] = t[0];
+                return p;}
+            const std::uint64_t off = (b < PAGE) ? h.top : (h.top + PAGE - 1) / PAGE * PAGE;
+            grow(off + b);
+            h.top = off + b;
+            return _base + off;}
+
+        // ----------
+        // deallocate
+        // ----------
+
+        /**
+         * Puts the chunk on its free list. A chunk of whole pages is listed in
+         * the first trunk and punched out of the file, or, if that trunk is
+         * full, becomes the first trunk and keeps only its first page. With no
+         * free list left for its size the chunk is simply dropped.
+         * @param p is a chunk from allocate(n)
+         * @param n is the size it was allocated with
+         */
+        void deallocate (void* p, std::size_t n) {
+            const std::uint64_t b = chunk_bytes(n);
+            const std::uint64_t off = static_cast<char*>(p) - _base;
+            header& h = head();
+            const std::size_t c = size_class(b);
+            if (c == CLASSES)
+                return;
+            if (b < PAGE) {
+                std::memcpy(p, &h.head[c], sizeof(std::uint64_t));
+                h.head[c] = off;
+                return;}
+            std::uint64_t* t = reinterpret_cast<std::uint64_t*>(_base + h.head[c]);
+            if (h.head[c] && t[1] != TRUNK_SLOTS) {
+                t[2 + t[1]++] = off;
+                punch(off, b);
+                return;}
+            t = static_cast<std::uint64_t*>(p);
+            t[0] = h.head[c];
+            t[1] = 0;
+            h.head[c] = off;
+            punch(off + PAGE, b - PAGE);}
+
+        // -----
+        // flush
+        // -----
+
+        /**
+         * Writes every dirty page back to the file.
+         * @throws system_error
+         */
+        void flush () {
+            if (::msync(_base, _file_size, MS_SYNC))
+                fail("deque_file_arena::flush()");}
+
+        // ---------
+        // accessors
+        // ---------
+
+        /**
+         * @return the header at the start of the mapping
+         */
+        header& get_header () {
+            return head();}
+
+        /**
+         * @return the address the file is mapped at
+         */
+        char* base () const {
+            return _base;}
+
+        /**
+         * @return the current length of the file
+         */
+        std::size_t file_size () const {
+            return _file_size;}};
+
+// -------------------
+// MappedFileAllocator
+// -------------------
+
+/**
+ * An allocator that hands out chunks of a deque_file_arena.
+ */
+template <typename T>
+class MappedFileAllocator {
+    public:
+        // --------
+        // typedefs
+        // --------
+
+        typedef T value_type;
+
+        template <typename U>
+        struct rebind {
+            typedef MappedFileAllocator<U> other;};
+
+        // -----------
+        // operator ==
+        // -----------
+
+        friend bool operator == (const MappedFileAllocator& lhs, const MappedFileAllocator& rhs) {
+            return lhs._arena == rhs._arena;}
+
+        friend bool operator != (const MappedFileAllocator& lhs, const MappedFileAllocator& rhs) {
+            return !(lhs == rhs);}
+
+    private:
+        // ----
+        // data
+        // ----
+
+        deque_file_arena* _arena;
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        /**
+         * @param a is the arena to allocate from
+         */
+        explicit MappedFileAllocator (deque_file_arena* a = 0) :
+                _arena(a)
+            {}
+
+        template <typename U>
+        MappedFileAllocator (const MappedFileAllocator<U>& that) :
+                _arena(that.arena())
+            {}
+
+        // --------
+        // allocate
+        // --------
+
+        T* allocate (std::size_t n) {
+            return static_cast<T*>(_arena->allocate(n * sizeof(T)));}
+
+        // ----------
+        // deallocate
+        // ----------
+
+        void deallocate (T* p, std::size_t n) {
+            _arena->deallocate(p, n * sizeof(T));}
+
+        // -----
+        // arena
+        // -----
+
+        deque_file_arena* arena () const {
+            return _arena;}};
+
+/**
+ * Rows of a page, so that each row is a chunk of whole pages that can be
+ * punched out of the file when it is freed.
+ */
+template <typename U>
+struct deque_row_size< MappedFileAllocator<U> > {
+    static const std::size_t value = (deque_file_arena::PAGE >= sizeof(U)) ? deque_file_arena::PAGE / sizeof(U) : 1;};
+
+// -----------
+// MappedDeque
+// -----------
+
+/**
+ * A MyDeque whose map and rows live in a memory-mapped file, so it can hold
+ * more than fits in memory and can be reopened later. The layout is written
+ * to the file header by flush() and by the destructor; on reopening, the map
+ * is relocated to the new mapping address and adopted without touching the
+ * elements. Rows are a page each; one released by pop_front() or pop_back()
+ * is punched out of the file and its place recycled, so a streaming
+ * push_back()/pop_front() workload keeps both the file's length and its
+ * disk blocks bounded.
+ * The file is only consistent as of the last flush().
+ */
+template <typename T>
+class MappedDeque {
+    public:
+        // --------
+        // typedefs
+        // --------
+
+        typedef MyDeque<T, MappedFileAllocator<T> > deque_type;
+        typedef typename deque_type::value_type      value_type;
+        typedef typename deque_type::size_type       size_type;
+        typedef typename deque_type::pointer         pointer;
+        typedef typename deque_type::reference       reference;
+        typedef typename deque_type::const_reference const_reference;
+        typedef typename deque_type::iterator        iterator;
+        typedef typename deque_type::const_iterator  const_iterator;
+
+        //Default address space reserved for the file: 1 TiB.
+        const static std::size_t DEFAULT_RESERVE = std::size_t(1) << 40;
+
+    private:
+        // ----
+        // data
+        // ----
+
+        deque_file_arena _arena;
+        deque_type       _deque;
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        /**
+         * Opens the deque stored in path, or creates an empty one.
+         * @param path is the backing file
+         * @param reserve is the most the file can grow to
+         * @throws system_error, or runtime_error if path holds something else
+         */
+        explicit MappedDeque (const std::string& path, std::size_t reserve = DEFAULT_RESERVE) :
+                _arena(path, sizeof(T), reserve),
+                _deque(MappedFileAllocator<T>(&_arena)) {
+            static_assert(std::is_trivially_copyable<T>::value, "MappedDeque needs a trivially copyable value_type");
+            deque_file_arena::header& h = _arena.get_header();
+            if (!h.map)
+                return;
+            const std::uintptr_t base = reinterpret_cast<std::uintptr_t>(_arena.base());
+            typename deque_type::layout l;
+            l.map      = reinterpret_cast<pointer*>(_arena.base() + h.map);
+            l.map_size = h.map_size;
+            l.start    = h.start;
+            l.size     = h.size;
+            if (h.base != base)
+                for (size_type i = 0; i != l.map_size; ++i)
+                    if (l.map[i])
+                        l.map[i] = reinterpret_cast<pointer>(reinterpret_cast<std::uintptr_t>(l.map[i]) - h.base + base);
+            h.base = base;
+            _deque.adopt(l);}
+
+        MappedDeque (const MappedDeque&) = delete;
+        MappedDeque& operator = (const MappedDeque&) = delete;
+
+        // ----------
+        // destructor
+        // ----------
+
+        /**
+         * Flushes and then lets go of the map and rows, which stay in the file.
+         */
+        ~MappedDeque () {
+            try {
+                flush();}
+            catch (...) {}
+            _deque.release();}
+
+        // -----
+        // flush
+        // -----
+
+        /**
+         * Saves the layout in the file header and syncs the file.
+         * @throws system_error
+         */
+        void flush () {
+            const typename deque_type::layout l = _deque.get_layout();
+            deque_file_arena::header& h = _arena.get_header();
+            h.base     = reinterpret_cast<std::uintptr_t>(_arena.base());
+            h.map      = l.map ? reinterpret_cast<char*>(l.map) - _arena.base() : 0;
+            h.map_size = l.map_size;
+            h.start    = l.start;
+            h.size     = l.size;
+            _arena.flush();}
+
+        // ---------
+        // accessors
+        // ---------
+
+        /**
+         * @return the underlying MyDeque
+         */
+        deque_type& deque () {
+            return _deque;}
+
+        const deque_type& deque () const {
+            return _deque;}
+
+        /**
+         * @return the current length of the backing file
+         */
+        std::size_t file_size () const {
+            return _arena.file_size();}
+
+        // ----------
+        // forwarding
+        // ----------
+
+        reference operator [] (size_type i) {
+            return _deque[i];}
+
+        const_reference operator [] (size_type i) const {
+            return _deque[i];}
+
+        reference back () {
+            return _deque.back();}
+
+        iterator begin () {
+            return _deque.begin();}
+
+        bool empty () const {
+            return _deque.empty();}
+
+        iterator end () {
+            return _deque.end();}
+
+        reference front () {
+            return _deque.front();}
+
+        void pop_back () {
+            _deque.pop_back();}
+
+        void pop_front () {
+            _deque.pop_front();}
+
+        void push_back (const_reference v) {
+            _deque.push_back(v);}
+
+        void push_front (const_reference v) {
+            _deque.push_front(v);}
+
+        size_type size () const {
+            return _deque.size();}};
+
+#endif // MappedDeque_h
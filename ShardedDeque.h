@@ -0,0 +1,349 @@
+// ------------------------------
+// projects/deque/ShardedDeque.h
+// ------------------------------
+
+#ifndef ShardedDeque_h
+#define ShardedDeque_h
+
+// --------
+// includes
+// --------
+
+#include <algorithm> // max, min
+#include <atomic>    // atomic, memory_order_relaxed
+#include <cassert>   // assert
+#include <cstddef>   // size_t
+#include <iterator>  // back_inserter
+#include <mutex>     // lock_guard, mutex
+#include <thread>    // thread
+#include <utility>   // move
+#include <vector>    // vector
+
+#include <sched.h>   // sched_getcpu
+
+#ifdef DEQUE_LIBNUMA
+#include <numa.h>    // numa_available, numa_node_of_cpu, numa_num_configured_nodes
+#endif
+
+#include "BlockAllocator.h"
+#include "Deque.h"
+
+// --------------
+// deque_topology
+// --------------
+
+/**
+ * The CPUs and NUMA nodes a ShardedDeque spreads over. Without DEQUE_LIBNUMA
+ * every CPU is taken to be on node 0.
+ */
+struct deque_topology {
+    /**
+     * @return the number of CPUs, at least 1
+     */
+    static int cpus () {
+        return std::max(1, static_cast<int>(std::thread::hardware_concurrency()));}
+
+    /**
+     * @return the CPU the calling thread is running on, 0 if unknown
+     */
+    static int current_cpu () {
+        return std::max(0, ::sched_getcpu());}
+
+    /**
+     * @return the number of NUMA nodes, at least 1
+     */
+    static int nodes () {
+#ifdef DEQUE_LIBNUMA
+        if (::numa_available() >= 0)
+            return std::max(1, ::numa_num_configured_nodes());
+#endif
+        return 1;}
+
+    /**
+     * @return the NUMA node of CPU c, 0 if unknown
+     */
+    static int node_of_cpu (int c) {
+#ifdef DEQUE_LIBNUMA
+        if (::numa_available() >= 0)
+            return std::max(0, ::numa_node_of_cpu(c));
+#endif
+        static_cast<void>(c);
+        return 0;}};
+
+// ------------
+// ShardedDeque
+// ------------
+
+/**
+ * A concurrent bag of FIFO shards: one MyDeque per CPU, or per NUMA node,
+ * each behind its own lock and with its rows and map in its own
+ * huge_page_arena bound to the shard's node. A push goes to the shard of the
+ * CPU the thread is on, so threads on different CPUs never contend; a pop
+ * takes from that shard's front and, when it is empty, steals the older half
+ * of the first other shard that has anything, in one batch.
+ *
+ * Ordering is relaxed, and that is the tradeoff for the scaling: elements
+ * pushed to one shard come out of it in the order they went in, but there is
+ * no order across shards, and stolen elements are appended to the thief's
+ * shard behind whatever it already holds. size() and empty() are snapshots.
+ * Use MyDeque behind one lock where a single global order matters.
+ */
+template <typename T>
+class ShardedDeque {
+    public:
+        // --------
+        // typedefs
+        // --------
+
+        typedef T           value_type;
+        typedef std::size_t size_type;
+
+        typedef MyDeque< T, HugePageAllocator<T> > shard_type;
+
+        /**
+         * What a shard stands for.
+         */
+        enum shard_by {
+            per_cpu,
+            per_node};
+
+        //Most elements one steal takes.
+        const static size_type STEAL_MAX = 4096;
+
+    private:
+        /**
+         * One shard, on a cache line of its own.
+         */
+        struct alignas(64) shard {
+            huge_page_arena        arena;
+            std::mutex             lock;
+            std::atomic<size_type> count; // items.size(), readable without the lock
+            shard_type             items;
+
+            explicit shard (int node) :
+                    arena(node),
+                    count(0),
+                    items(HugePageAllocator<T>(&arena))
+                {}};
+
+        // ----
+        // data
+        // ----
+
+        std::vector<shard*> _shards;
+        std::vector<size_type> _shard_of_cpu;
+
+    private:
+        // -----
+        // valid
+        // -----
+
+        bool valid () const {
+            return !_shards.empty() && !_shard_of_cpu.empty();}
+
+        /**
+         * Moves the front of shard s into out.
+         */
+        bool pop_from (size_type s, T& out) {
+            shard& h = *_shards[s];
+            if (!h.count.load(std::memory_order_relaxed))
+                return false;
+            std::lock_guard<std::mutex> g(h.lock);
+            if (h.items.empty())
+                return false;
+            out = std::move(h.items.front());
+            h.items.pop_front();
+            h.count.store(h.items.size(), std::memory_order_relaxed);
+            return true;}
+
+        /**
+         * Takes the older half of shard v, at most STEAL_MAX elements, moves
+         * the first into out and moves the rest onto the back of shard s. If
+         * that throws, whatever is left goes back to the front of shard v;
+         * out still got its element, so the steal succeeded.
+         */
+        bool steal (size_type v, size_type s, T& out) {
+            shard& h = *_shards[v];
+            if (!h.count.load(std::memory_order_relaxed))
+                return false;
+            std::vector<T> batch;
+            {
+            std::lock_guard<std::mutex> g(h.lock);
+            if (h.items.empty())
+                return false;
+            const size_type k = std::min<size_type>((h.items.size() + 1) / 2, STEAL_MAX);
+            batch.reserve(k);
+            h.items.pop_front_n(std::back_inserter(batch), k);
+            h.count.store(h.items.size(), std::memory_order_relaxed);
+            }
+            size_type i = 0;
+            try {
+                out = std::move(batch.front());
+                i = 1;
+                shard& t = *_shards[s];
+                std::lock_guard<std::mutex> g(t.lock);
+                try {
+                    for (; i != batch.size(); ++i)
+                        t.items.push_back(std::move(batch[i]));}
+                catch (...) {
+                    t.count.store(t.items.size(), std::memory_order_relaxed);
+                    throw;}
+                t.count.store(t.items.size(), std::memory_order_relaxed);}
+            catch (...) {
+                std::lock_guard<std::mutex> g(h.lock);
+                for (size_type j = batch.size(); j != i; --j)
+                    h.items.push_front(std::move(batch[j - 1]));
+                h.count.store(h.items.size(), std::memory_order_relaxed);
+                if (!i)
+                    throw;}
+            return true;}
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        /**
+         * @param by is per_cpu or per_node -- defaulted
+         */
+        explicit ShardedDeque (shard_by by = per_cpu) {
+            const int cpus  = deque_topology::cpus();
+            const int count = (by == per_cpu) ? cpus : deque_topology::nodes();
+            init(count, by);}
+
+        /**
+         * @param n is the number of shards; CPU c pushes to shard c % n
+         */
+        explicit ShardedDeque (size_type n) {
+            init(static_cast<int>(std::max<size_type>(n, 1)), per_cpu);}
+
+        ShardedDeque (const ShardedDeque&) = delete;
+        ShardedDeque& operator = (const ShardedDeque&) = delete;
+
+        // ----------
+        // destructor
+        // ----------
+
+        ~ShardedDeque () {
+            for (size_type s = 0; s != _shards.size(); ++s)
+                delete _shards[s];}
+
+    private:
+        void init (int count, shard_by by) {
+            const int cpus = deque_topology::cpus();
+            _shard_of_cpu.resize(cpus);
+            for (int c = 0; c != cpus; ++c)
+                _shard_of_cpu[c] = ((by == per_cpu) ? c : deque_topology::node_of_cpu(c)) % count;
+            _shards.reserve(count);
+            for (int s = 0; s != count; ++s) {
+                const int node = (by == per_cpu) ? deque_topology::node_of_cpu(s % cpus) : s;
+                _shards.push_back(new shard(deque_topology::nodes() > 1 ? node : -1));}
+            assert(valid());}
+
+    public:
+        // -----
+        // empty
+        // -----
+
+        bool empty () const {
+            return !size();}
+
+        // -----------
+        // local_shard
+        // -----------
+
+        /**
+         * @return the shard of the CPU the calling thread is on
+         */
+        size_type local_shard () const {
+            const size_type c = deque_topology::current_cpu();
+            return (c < _shard_of_cpu.size()) ? _shard_of_cpu[c] : c % _shards.size();}
+
+        // ---------
+        // push_back
+        // ---------
+
+        /**
+         * Appends v to the local shard.
+         */
+        void push_back (const T& v) {
+            push_back(v, local_shard());}
+
+        /**
+         * Appends v to shard s.
+         */
+        void push_back (const T& v, size_type s) {
+            shard& h = *_shards[s];
+            std::lock_guard<std::mutex> g(h.lock);
+            h.items.push_back(v);
+            h.count.store(h.items.size(), std::memory_order_relaxed);}
+
+        /**
+         * Appends [p, p + n) to the local shard under one lock.
+         */
+        void push_back_n (const T* p, size_type n) {
+            push_back_n(p, n, local_shard());}
+
+        /**
+         * Appends [p, p + n) to shard s under one lock.
+         */
+        void push_back_n (const T* p, size_type n, size_type s) {
+            shard& h = *_shards[s];
+            std::lock_guard<std::mutex> g(h.lock);
+            h.items.push_back_n(p, n);
+            h.count.store(h.items.size(), std::memory_order_relaxed);}
+
+        // ------
+        // shards
+        // ------
+
+        size_type shards () const {
+            return _shards.size();}
+
+        /**
+         * @return the number of elements in shard s, a snapshot
+         */
+        size_type shard_size (size_type s) const {
+            return _shards[s]->count.load(std::memory_order_relaxed);}
+
+        // ----
+        // size
+        // ----
+
+        /**
+         * @return the number of elements, a snapshot that concurrent pushes and pops outdate
+         */
+        size_type size () const {
+            size_type n = 0;
+            for (size_type s = 0; s != _shards.size(); ++s)
+                n += shard_size(s);
+            return n;}
+
+        // -------
+        // try_pop
+        // -------
+
+        /**
+         * Moves an element into out, from the local shard if it has one.
+         * @return false if every shard was empty when looked at
+         */
+        bool try_pop (T& out) {
+            return try_pop(out, local_shard());}
+
+        /**
+         * Moves an element into out from shard s, stealing from the other
+         * shards in turn when s is empty.
+         * @return false if every shard was empty when looked at
+         */
+        bool try_pop (T& out, size_type s) {
+            if (pop_from(s, out))
+                return true;
+            for (size_type i = 1; i != _shards.size(); ++i)
+                if (steal((s + i) % _shards.size(), s, out))
+                    return true;
+            return false;}};
+
+template <typename T>
+const typename ShardedDeque<T>::size_type ShardedDeque<T>::STEAL_MAX;
+
+#endif // ShardedDeque_h
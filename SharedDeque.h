@@ -0,0 +1,527 @@
+// -----------------------------
+// projects/deque/SharedDeque.h
+// -----------------------------
+
+#ifndef SharedDeque_h
+#define SharedDeque_h
+
+// --------
+// includes
+// --------
+
+#include <algorithm>    // min
+#include <atomic>       // atomic, ATOMIC_INT_LOCK_FREE, ATOMIC_LLONG_LOCK_FREE
+#include <cassert>      // assert
+#include <cerrno>       // errno
+#include <chrono>       // milliseconds
+#include <cstddef>      // size_t
+#include <cstdint>      // uint32_t, uint64_t
+#include <cstring>      // memcmp, memcpy
+#include <new>          // placement new
+#include <stdexcept>    // runtime_error
+#include <string>       // string
+#include <system_error> // system_error
+#include <thread>       // sleep_for, this_thread
+#include <type_traits>  // is_trivially_copyable
+
+#include <fcntl.h>         // O_*
+#include <linux/futex.h>   // FUTEX_WAIT, FUTEX_WAKE
+#include <sys/mman.h>      // mmap, munmap, shm_open, shm_unlink
+#include <sys/stat.h>      // fstat
+#include <sys/syscall.h>   // SYS_futex
+#include <unistd.h>        // close, ftruncate, syscall
+
+// -----------------
+// deque_shm_segment
+// -----------------
+
+/**
+ * A POSIX shared memory object mapped MAP_SHARED, by name, so that another
+ * process can map the same bytes, most likely at another address.
+ */
+class deque_shm_segment {
+    public:
+        //Milliseconds an opener waits for the creator to size the object.
+        const static int OPEN_WAIT_MS = 1000;
+
+    private:
+        // ----
+        // data
+        // ----
+
+        char*       _base;
+        std::size_t _size;
+
+    private:
+        /**
+         * @throws system_error for errno
+         */
+        static void fail (const char* what) {
+            throw std::system_error(errno, std::generic_category(), what);}
+
+        void map (int fd) {
+            void* p = ::mmap(0, _size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (p == MAP_FAILED)
+                fail("deque_shm_segment::map()");
+            _base = static_cast<char*>(p);}
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        /**
+         * Creates the object name, zero filled, and maps it.
+         * @param name is "/" followed by a name of no more slashes
+         * @param size is the number of bytes
+         * @throws system_error, if name already exists among others
+         */
+        deque_shm_segment (const std::string& name, std::size_t size) :
+                _base(0),
+                _size(size) {
+            const int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+            if (fd < 0)
+                fail("deque_shm_segment::deque_shm_segment()");
+            if (::ftruncate(fd, size)) {
+                const int e = errno;
+                ::close(fd);
+                ::shm_unlink(name.c_str());
+                errno = e;
+                fail("deque_shm_segment::deque_shm_segment()");}
+            try {
+                map(fd);}
+            catch (...) {
+                ::shm_unlink(name.c_str());
+                throw;}}
+
+        /**
+         * Maps the existing object name, all of it. An object found between
+         * its creator's shm_open() and ftruncate() is still empty, so this
+         * waits up to OPEN_WAIT_MS for it to be sized.
+         * @throws system_error, with EINVAL if it stays empty
+         */
+        explicit deque_shm_segment (const std::string& name) :
+                _base(0),
+                _size(0) {
+            const int fd = ::shm_open(name.c_str(), O_RDWR, 0);
+            if (fd < 0)
+                fail("deque_shm_segment::deque_shm_segment()");
+            struct stat st;
+            for (int i = 0; ; ++i) {
+                if (::fstat(fd, &st)) {
+                    ::close(fd);
+                    fail("deque_shm_segment::deque_shm_segment()");}
+                if (st.st_size || i == OPEN_WAIT_MS)
+                    break;
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));}
+            _size = st.st_size;
+            map(fd);}
+
+        deque_shm_segment (const deque_shm_segment&) = delete;
+        deque_shm_segment& operator = (const deque_shm_segment&) = delete;
+
+        // ----------
+        // destructor
+        // ----------
+
+        /**
+         * Unmaps the object; it lives on until unlinked and unmapped everywhere.
+         */
+        ~deque_shm_segment () {
+            ::munmap(_base, _size);}
+
+        // ------
+        // unlink
+        // ------
+
+        /**
+         * Removes name, so that no one else can open it.
+         * @return false if there was no such object
+         */
+        static bool unlink (const std::string& name) {
+            return !::shm_unlink(name.c_str());}
+
+        // ---------
+        // accessors
+        // ---------
+
+        char* base () const {
+            return _base;}
+
+        std::size_t size () const {
+            return _size;}};
+
+// -----------
+// SharedDeque
+// -----------
+
+/**
+ * A bounded FIFO of trivially copyable records in a shared memory segment,
+ * for handing records from one process, the producer, to another, the
+ * consumer, with no pipe and no serialization in between.
+ *
+ * The segment is laid out like a MyDeque: a header, a map, and rows of S
+ * elements that the producer allocates from the segment on first use and
+ * reuses from then on. The map holds offsets from the start of the segment
+ * rather than pointers, because each process maps the segment at its own
+ * address. Element e lives in the row of map slot (e / S) % R.
+ *
+ * The handoff is lock-free: the producer copies records into the rows and
+ * then publishes a new tail, the consumer reads them in place and then
+ * publishes a new head. A side that has to wait, for records or for room,
+ * spins briefly and then sleeps on a futex in the segment, which the other
+ * side wakes only when a sleeper has said so. Batches with push_back_n() and
+ * consume() publish once per run of a row rather than once per record.
+ *
+ * There must be at most one producer and one consumer at a time; they may
+ * be threads of one process just as well as two processes.
+ */
+template <typename T>
+class SharedDeque {
+    static_assert(std::is_trivially_copyable<T>::value, "SharedDeque needs a trivially copyable value_type");
+    static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2, "SharedDeque needs address-free atomics");
+
+    public:
+        // --------
+        // typedefs
+        // --------
+
+        typedef T           value_type;
+        typedef std::size_t size_type;
+
+        //Size of the header, which the map follows.
+        const static size_type PAGE = 4096;
+
+        //Bytes in each row; a row holds ROW_BYTES / sizeof(T) elements, at least 1.
+        const static size_type ROW_BYTES = 1 << 16;
+
+        //Times a waiting side polls before it sleeps.
+        const static int SPIN = 256;
+
+    private:
+        enum {
+            CONSUMER_WAITING = 1,
+            PRODUCER_WAITING = 2};
+
+        /**
+         * The first page of the segment. head and tail count every element
+         * ever popped and pushed; only the consumer writes head and only the
+         * producer writes tail, top, map and the rows.
+         */
+        struct header {
+            char                       magic[8];    // "MYDQSHM1"
+            std::uint64_t              value_size;  // sizeof(T)
+            std::uint64_t              row_size;    // S
+            std::uint64_t              slots;       // R
+            std::uint64_t              top;         // end of the highest row handed out
+            alignas(64) std::atomic<std::uint64_t> head;
+            alignas(64) std::atomic<std::uint64_t> tail;
+            alignas(64) std::atomic<std::uint32_t> pushed;  // futex word a waiting consumer sleeps on
+            std::atomic<std::uint32_t> popped;  // futex word a waiting producer sleeps on
+            std::atomic<std::uint32_t> waiting; // CONSUMER_WAITING | PRODUCER_WAITING
+            std::atomic<std::uint32_t> closed;
+            std::atomic<std::uint32_t> ready;   // set once the creator has filled in the header
+        };
+
+        // ----
+        // data
+        // ----
+
+        deque_shm_segment _segment;
+        header*           _h;
+        std::uint64_t*    _map;      // offsets of the rows, 0 for none
+        size_type         _row_size; // S
+        size_type         _slots;    // R
+        std::uint64_t     _head_seen; // head as the producer last loaded it, never ahead of head
+        std::uint64_t     _tail_seen; // tail as the consumer last loaded it, never ahead of tail
+
+    private:
+        // -----
+        // valid
+        // -----
+
+        bool valid () const {
+            const std::uint64_t h = _h->head.load(std::memory_order_relaxed);
+            const std::uint64_t t = _h->tail.load(std::memory_order_relaxed);
+            return (h <= t) && (t - h <= capacity()) && (_h->top <= _segment.size());}
+
+        /**
+         * @return S for a new deque
+         */
+        static size_type row_elements () {
+            return std::max<size_type>(1, ROW_BYTES / sizeof(T));}
+
+        /**
+         * @return R for a new deque of at least capacity elements
+         */
+        static size_type slots_for (size_type capacity) {
+            return std::max<size_type>(2, (capacity + row_elements() - 1) / row_elements());}
+
+        /**
+         * @return the bytes a segment of R slots of rows of S takes
+         */
+        static size_type segment_size (size_type s, size_type r) {
+            return PAGE + (r * sizeof(std::uint64_t) + 63) / 64 * 64 + r * ((s * sizeof(T) + 63) / 64 * 64);}
+
+        static void futex_wait (std::atomic<std::uint32_t>& w, std::uint32_t v) {
+            ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&w), FUTEX_WAIT, v, 0, 0, 0);}
+
+        static void futex_wake (std::atomic<std::uint32_t>& w) {
+            ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&w), FUTEX_WAKE, 1, 0, 0, 0);}
+
+        /**
+         * Returns once ready() holds, sleeping on event with bit set in
+         * waiting after a few polls. The other side bumps event and wakes
+         * it after publishing, if it then sees bit; both sides' stores and
+         * loads are sequentially consistent, so one of them sees the other.
+         */
+        template <typename P>
+        void wait (std::atomic<std::uint32_t>& event, std::uint32_t bit, P ready) {
+            for (int i = 0; i != SPIN; ++i) {
+                if (ready())
+                    return;
+                std::this_thread::yield();}
+            for (;;) {
+                const std::uint32_t e = event.load();
+                _h->waiting.fetch_or(bit);
+                if (ready())
+                    break;
+                futex_wait(event, e);}
+            _h->waiting.fetch_and(~bit);}
+
+        void wake (std::atomic<std::uint32_t>& event, std::uint32_t bit) {
+            if (_h->waiting.load() & bit) {
+                event.fetch_add(1);
+                futex_wake(event);}}
+
+        /**
+         * @return the row of element e, allocating it if the producer asks first
+         */
+        T* row (std::uint64_t e) {
+            std::uint64_t& off = _map[(e / _row_size) % _slots];
+            if (!off) {
+                off = _h->top;
+                _h->top += (_row_size * sizeof(T) + 63) / 64 * 64;}
+            return reinterpret_cast<T*>(_segment.base() + off);}
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        /**
+         * Creates the segment name for at least capacity elements.
+         * @throws system_error, if name already exists among others
+         */
+        SharedDeque (const std::string& name, size_type capacity) :
+                _segment(name, segment_size(row_elements(), slots_for(capacity))),
+                _h(reinterpret_cast<header*>(_segment.base())),
+                _map(reinterpret_cast<std::uint64_t*>(_segment.base() + PAGE)),
+                _row_size(row_elements()),
+                _slots(slots_for(capacity)),
+                _head_seen(0),
+                _tail_seen(0) {
+            static_assert(sizeof(header) <= PAGE, "the header fits in a page");
+            header* h = new (_segment.base()) header();
+            std::memcpy(h->magic, "MYDQSHM1", 8);
+            h->value_size = sizeof(T);
+            h->row_size   = _row_size;
+            h->slots      = _slots;
+            h->top        = PAGE + (_slots * sizeof(std::uint64_t) + 63) / 64 * 64;
+            h->ready.store(1);
+            assert(valid());}
+
+        /**
+         * Opens the segment name, made by another SharedDeque<T>, waiting up
+         * to deque_shm_segment::OPEN_WAIT_MS for its creator to fill in the
+         * header.
+         * @throws system_error, or runtime_error if name holds something else
+         * or its header is still not filled in
+         */
+        explicit SharedDeque (const std::string& name) :
+                _segment(name),
+                _h(reinterpret_cast<header*>(_segment.base())),
+                _map(reinterpret_cast<std::uint64_t*>(_segment.base() + PAGE)),
+                _row_size(0),
+                _slots(0),
+                _head_seen(0),
+                _tail_seen(0) {
+            if (_segment.size() < PAGE)
+                throw std::runtime_error("SharedDeque::SharedDeque(): not a deque of this type");
+            for (int i = 0; !_h->ready.load(); ++i) {
+                if (i == deque_shm_segment::OPEN_WAIT_MS)
+                    throw std::runtime_error("SharedDeque::SharedDeque(): not a deque of this type");
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));}
+            if (std::memcmp(_h->magic, "MYDQSHM1", 8) || _h->value_size != sizeof(T) || segment_size(_h->row_size, _h->slots) != _segment.size())
+                throw std::runtime_error("SharedDeque::SharedDeque(): not a deque of this type");
+            _row_size  = _h->row_size;
+            _slots     = _h->slots;
+            _head_seen = _h->head.load();
+            _tail_seen = _h->tail.load();}
+
+        SharedDeque (const SharedDeque&) = delete;
+        SharedDeque& operator = (const SharedDeque&) = delete;
+
+        // --------
+        // capacity
+        // --------
+
+        /**
+         * @return R * S, the most elements the deque holds at once
+         */
+        size_type capacity () const {
+            return _row_size * _slots;}
+
+        // -----
+        // close
+        // -----
+
+        /**
+         * Says the producer is done; the consumer drains what is left and
+         * then its pops fail instead of waiting.
+         */
+        void close () {
+            _h->closed.store(1);
+            _h->pushed.fetch_add(1);
+            futex_wake(_h->pushed);}
+
+        // -------
+        // consume
+        // -------
+
+        /**
+         * Waits for elements and calls f(p, k) on up to n of them in place,
+         * the longest run of one row, before giving their room back. tail is
+         * only loaded again once the elements up to the last tail seen are
+         * used up.
+         * @param f is called as f(const T*, size_type)
+         * @return k, 0 if the deque is closed and empty
+         */
+        template <typename F>
+        size_type consume (F f, size_type n = size_type(-1)) {
+            const std::uint64_t h = _h->head.load(std::memory_order_relaxed);
+            if (_tail_seen == h) {
+                wait(_h->pushed, CONSUMER_WAITING, [this, h] () {
+                    _tail_seen = _h->tail.load();
+                    return _tail_seen != h || _h->closed.load();});
+                // closed may have been seen after a tail from before the last push
+                _tail_seen = _h->tail.load();
+                if (_tail_seen == h)
+                    return 0;}
+            const std::uint64_t t = _tail_seen;
+            const size_type k = std::min<std::uint64_t>(std::min<std::uint64_t>(t - h, n), _row_size - h % _row_size);
+            f(static_cast<const T*>(reinterpret_cast<T*>(_segment.base() + _map[(h / _row_size) % _slots]) + h % _row_size), k);
+            _h->head.store(h + k);
+            wake(_h->popped, PRODUCER_WAITING);
+            return k;}
+
+        // -----
+        // empty
+        // -----
+
+        bool empty () const {
+            return !size();}
+
+        // ---------
+        // pop_front
+        // ---------
+
+        /**
+         * Waits for an element and moves it into out.
+         * @return false if the deque is closed and empty
+         */
+        bool pop_front (T& out) {
+            return consume([&out] (const T* p, size_type) {
+                std::memcpy(&out, p, sizeof(T));}, 1) != 0;}
+
+        /**
+         * Waits for elements and copies up to n of them to out, as many as
+         * are there once the first has arrived; returns at once if n is 0.
+         * @return the number copied, 0 if the deque is closed and empty
+         */
+        size_type pop_front_n (T* out, size_type n) {
+            if (!n)
+                return 0;
+            size_type m = 0;
+            do {
+                m += consume([out, m] (const T* p, size_type k) {
+                    std::memcpy(out + m, p, k * sizeof(T));}, n - m);}
+            while (m && m != n && !empty());
+            return m;}
+
+        // ---------
+        // push_back
+        // ---------
+
+        /**
+         * Waits for room and appends v.
+         */
+        void push_back (const T& v) {
+            push_back_n(&v, 1);}
+
+        /**
+         * Appends [p, p + n), waiting for room as needed and publishing a
+         * run of a row at a time. head is only loaded again once the room
+         * left by the last head seen is used up.
+         */
+        void push_back_n (const T* p, size_type n) {
+            const size_type c = capacity();
+            while (n) {
+                const std::uint64_t t = _h->tail.load(std::memory_order_relaxed);
+                if (t - _head_seen == c)
+                    wait(_h->popped, PRODUCER_WAITING, [this, t, c] () {
+                        _head_seen = _h->head.load();
+                        return t - _head_seen < c;});
+                const size_type k = std::min<std::uint64_t>(std::min<std::uint64_t>(n, c - (t - _head_seen)), _row_size - t % _row_size);
+                std::memcpy(row(t) + t % _row_size, p, k * sizeof(T));
+                _h->tail.store(t + k);
+                wake(_h->pushed, CONSUMER_WAITING);
+                p += k;
+                n -= k;}
+            assert(valid());}
+
+        /**
+         * Appends v if there is room, without waiting.
+         * @return false if the deque was full
+         */
+        bool try_push_back (const T& v) {
+            const std::uint64_t t = _h->tail.load(std::memory_order_relaxed);
+            if (t - _head_seen == capacity())
+                _head_seen = _h->head.load();
+            if (t - _head_seen == capacity())
+                return false;
+            push_back(v);
+            return true;}
+
+        // ----
+        // size
+        // ----
+
+        /**
+         * @return the number of elements, a snapshot
+         */
+        size_type size () const {
+            const std::uint64_t h = _h->head.load();
+            return _h->tail.load() - h;}
+
+        // ------
+        // unlink
+        // ------
+
+        /**
+         * Removes the segment name; mappings already made keep working.
+         */
+        static bool unlink (const std::string& name) {
+            return deque_shm_segment::unlink(name);}};
+
+template <typename T>
+const typename SharedDeque<T>::size_type SharedDeque<T>::PAGE;
+
+template <typename T>
+const typename SharedDeque<T>::size_type SharedDeque<T>::ROW_BYTES;
+
+template <typename T>
+const int SharedDeque<T>::SPIN;
+
+#endif // SharedDeque_h
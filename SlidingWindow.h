@@ -0,0 +1,336 @@
+// ------------------------------
+// projects/deque/SlidingWindow.h
+// ------------------------------
+
+#ifndef SlidingWindow_h
+#define SlidingWindow_h
+
+// --------
+// includes
+// --------
+
+#include <cassert>    // assert
+#include <cstddef>    // size_t
+#include <functional> // less, plus
+
+#include "Deque.h"
+
+// -------------
+// SlidingWindow
+// -------------
+
+/**
+ * A FIFO window of samples that keeps op(first, ..., last) up to date in
+ * amortized O(1) per push and pop, for any associative Op (it need not be
+ * commutative or invertible). This is two-stack aggregation: the older
+ * samples carry suffix aggregates that are rebuilt in one pass whenever they
+ * run out, and the newer samples fold into a single running aggregate.
+ * Each sample has a timestamp so that the window can expire by count or by
+ * age.
+ */
+template <typename T, typename Op = std::plus<T>, typename Time = long long>
+class SlidingWindow {
+    public:
+        // --------
+        // typedefs
+        // --------
+
+        typedef T           value_type;
+        typedef Op          operation_type;
+        typedef Time        time_type;
+        typedef std::size_t size_type;
+
+    private:
+        // ----
+        // data
+        // ----
+
+        MyDeque<T>    _values;
+        MyDeque<Time> _times;
+        MyDeque<T>    _front; // _front[j] is op(_values[j], ..., _values[_front.size() - 1])
+        T             _back;  // op over the samples after the ones _front covers
+        Op            _op;
+
+    private:
+        // -----
+        // valid
+        // -----
+
+        bool valid () const {
+            return (_values.size() == _times.size()) && (_front.size() <= _values.size());}
+
+        /**
+         * Moves every sample into the suffix aggregates.
+         */
+        void flip () {
+            assert(_front.empty());
+            size_type i = _values.size();
+            if (!i)
+                return;
+            T a = _values[--i];
+            _front.push_front(a);
+            while (i) {
+                a = _op(_values[--i], a);
+                _front.push_front(a);}}
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        /**
+         * @param op is an Op by reference -- defaulted
+         */
+        explicit SlidingWindow (const Op& op = Op()) :
+                _back(),
+                _op(op)
+            {}
+
+        // ---------
+        // aggregate
+        // ---------
+
+        /**
+         * @return op over every sample in the window, oldest first; the window must not be empty
+         */
+        T aggregate () const {
+            assert(!empty());
+            if (_front.empty())
+                return _back;
+            if (_front.size() == _values.size())
+                return _front.front();
+            return _op(_front.front(), _back);}
+
+        // ----------
+        // back/front
+        // ----------
+
+        const T& back () const {
+            return _values.back();}
+
+        const T& front () const {
+            return _values.front();}
+
+        // -----
+        // clear
+        // -----
+
+        void clear () {
+            _values.clear();
+            _times.clear();
+            _front.clear();}
+
+        // -----
+        // empty
+        // -----
+
+        bool empty () const {
+            return _values.empty();}
+
+        // ------
+        // expire
+        // ------
+
+        /**
+         * Drops the oldest samples until at most n are left.
+         * @return the number of samples dropped
+         */
+        size_type expire_count (size_type n) {
+            size_type k = 0;
+            for (; _values.size() > n; ++k)
+                pop_front();
+            return k;}
+
+        /**
+         * Drops the samples stamped before t, oldest first.
+         * @return the number of samples dropped
+         */
+        size_type expire_before (const Time& t) {
+            size_type k = 0;
+            for (; !_times.empty() && _times.front() < t; ++k)
+                pop_front();
+            return k;}
+
+        // ---------
+        // pop_front
+        // ---------
+
+        /**
+         * Drops the oldest sample.
+         */
+        void pop_front () {
+            if (_front.empty())
+                flip();
+            _front.pop_front();
+            _values.pop_front();
+            _times.pop_front();
+            assert(valid());}
+
+        // ---------
+        // push_back
+        // ---------
+
+        /**
+         * @param v is the new sample
+         * @param t is its timestamp -- defaulted
+         */
+        void push_back (const T& v, const Time& t = Time()) {
+            _back = (_front.size() == _values.size()) ? v : _op(_back, v);
+            _values.push_back(v);
+            _times.push_back(t);
+            assert(valid());}
+
+        // ----
+        // size
+        // ----
+
+        size_type size () const {
+            return _values.size();}};
+
+// ---------------
+// MonotonicWindow
+// ---------------
+
+/**
+ * A FIFO window of samples that reports the extreme sample, the minimum for
+ * std::less and the maximum for std::greater, in O(1). Only the samples that
+ * can still become the extreme are kept, in a monotonic MyDeque, so push and
+ * pop are amortized O(1) and the other samples cost just their timestamp.
+ */
+template <typename T, typename Compare = std::less<T>, typename Time = long long>
+class MonotonicWindow {
+    public:
+        // --------
+        // typedefs
+        // --------
+
+        typedef T           value_type;
+        typedef Compare     compare_type;
+        typedef Time        time_type;
+        typedef std::size_t size_type;
+
+    private:
+        struct entry {
+            T         value;
+            size_type seq;}; // position in the order of push_back calls
+
+        // ----
+        // data
+        // ----
+
+        MyDeque<entry> _mono;  // strictly ordered by Compare from front to back
+        MyDeque<Time>  _times; // one per sample in the window
+        size_type      _first; // seq of the oldest sample
+        Compare        _less;
+
+    private:
+        // -----
+        // valid
+        // -----
+
+        bool valid () const {
+            return _mono.size() <= _times.size() && (_mono.empty() == _times.empty());}
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        /**
+         * @param c is a Compare by reference -- defaulted
+         */
+        explicit MonotonicWindow (const Compare& c = Compare()) :
+                _first(0),
+                _less(c)
+            {}
+
+        // -----
+        // clear
+        // -----
+
+        void clear () {
+            _first += _times.size();
+            _mono.clear();
+            _times.clear();}
+
+        // -----
+        // empty
+        // -----
+
+        bool empty () const {
+            return _times.empty();}
+
+        // ------
+        // expire
+        // ------
+
+        /**
+         * Drops the oldest samples until at most n are left.
+         * @return the number of samples dropped
+         */
+        size_type expire_count (size_type n) {
+            size_type k = 0;
+            for (; _times.size() > n; ++k)
+                pop_front();
+            return k;}
+
+        /**
+         * Drops the samples stamped before t, oldest first.
+         * @return the number of samples dropped
+         */
+        size_type expire_before (const Time& t) {
+            size_type k = 0;
+            for (; !_times.empty() && _times.front() < t; ++k)
+                pop_front();
+            return k;}
+
+        // -------
+        // extreme
+        // -------
+
+        /**
+         * @return the first sample in Compare order; the window must not be empty
+         */
+        const T& extreme () const {
+            assert(!empty());
+            return _mono.front().value;}
+
+        // ---------
+        // pop_front
+        // ---------
+
+        /**
+         * Drops the oldest sample.
+         */
+        void pop_front () {
+            if (_mono.front().seq == _first)
+                _mono.pop_front();
+            _times.pop_front();
+            ++_first;
+            assert(valid());}
+
+        // ---------
+        // push_back
+        // ---------
+
+        /**
+         * Drops the kept samples that v now dominates, then keeps v.
+         * @param v is the new sample
+         * @param t is its timestamp -- defaulted
+         */
+        void push_back (const T& v, const Time& t = Time()) {
+            while (!_mono.empty() && !_less(_mono.back().value, v))
+                _mono.pop_back();
+            const entry e = {v, _first + _times.size()};
+            _mono.push_back(e);
+            _times.push_back(t);
+            assert(valid());}
+
+        // ----
+        // size
+        // ----
+
+        size_type size () const {
+            return _times.size();}};
+
+#endif // SlidingWindow_h
@@ -0,0 +1,442 @@
+// ------------------------------
+// projects/deque/SnapshotDeque.h
+// ------------------------------
+
+#ifndef SnapshotDeque_h
+#define SnapshotDeque_h
+
+// --------
+// includes
+// --------
+
+#include <algorithm>   // min, swap
+#include <atomic>      // atomic
+#include <cassert>     // assert
+#include <cstddef>     // size_t, ptrdiff_t
+#include <iterator>    // random_access_iterator_tag
+#include <memory>      // addressof, unique_ptr
+#include <new>         // placement new
+#include <stdexcept>   // out_of_range
+#include <type_traits> // aligned_storage
+
+#include "Deque.h"
+
+// ------------
+// snapshot_row
+// ------------
+
+/**
+ * S elements plus the number of SnapshotDeques that hold the row.
+ * A row held by more than one deque is never modified, so every holder sees
+ * the same live elements in it and the last one to let go destroys them.
+ */
+template <typename T, std::size_t S>
+struct snapshot_row {
+    std::atomic<std::size_t> refs;
+    typename std::aligned_storage<sizeof(T) * S, alignof(T)>::type data;
+
+    snapshot_row () :
+            refs(1)
+        {}
+
+    T* at (std::size_t i) {
+        return reinterpret_cast<T*>(&data) + i;}};
+
+// -------------
+// SnapshotDeque
+// -------------
+
+/**
+ * A deque whose copies share rows. The rows are reference counted and held in
+ * a MyDeque of row pointers, so snapshot() (or the copy constructor) copies
+ * that map and bumps the counts: O(size() / S), with no element copies.
+ * Before the writer changes a row that is shared it clones just that row, so
+ * memory grows with what changed since a snapshot was taken.
+ * A snapshot can be read on another thread without locks while the original
+ * keeps changing; any one SnapshotDeque object is not itself thread-safe.
+ */
+template <typename T, std::size_t S = 64>
+class SnapshotDeque {
+    public:
+        // --------
+        // typedefs
+        // --------
+
+        typedef T                  value_type;
+        typedef std::size_t        size_type;
+        typedef std::ptrdiff_t     difference_type;
+        typedef T&                 reference;
+        typedef const T&           const_reference;
+        typedef snapshot_row<T, S> row;
+
+        //Number of elements in a row.
+        const static size_type ROW_SIZE = S;
+
+    private:
+        // ----
+        // data
+        // ----
+
+        MyDeque<row*> _rows;
+        size_type     _offset; // index of the front element in _rows.front()
+        size_type     _size;
+
+    private:
+        // -----
+        // valid
+        // -----
+
+        bool valid () const {
+            return (_offset < S) && (_offset + _size <= _rows.size() * S) && (_offset + _size + S > _rows.size() * S);}
+
+        /**
+         * @return the first live offset in row r
+         */
+        size_type lo (size_type r) const {
+            return r ? 0 : _offset;}
+
+        /**
+         * @return one past the last live offset in row r
+         */
+        size_type hi (size_type r) const {
+            return std::min(S, _offset + _size - r * S);}
+
+        /**
+         * Drops one reference to p; the last holder destroys [b, e) and frees it.
+         */
+        static void release (row* p, size_type b, size_type e) {
+            if (p->refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+                return;
+            while (b != e)
+                p->at(b++)->~T();
+            delete p;}
+
+        /**
+         * Makes row r private to this deque, cloning it if it is shared.
+         */
+        void make_unique (size_type r) {
+            row* p = _rows[r];
+            if (p->refs.load(std::memory_order_acquire) == 1)
+                return;
+            const size_type b = lo(r);
+            const size_type e = hi(r);
+            row* q = new row;
+            size_type i = b;
+            try {
+                for (; i != e; ++i)
+                    new (q->at(i)) T(*p->at(i));}
+            catch (...) {
+                while (i != b)
+                    q->at(--i)->~T();
+                delete q;
+                throw;}
+            _rows[r] = q;
+            release(p, b, e);}
+
+    public:
+        // --------------
+        // const_iterator
+        // --------------
+
+        class const_iterator {
+            public:
+                // --------
+                // typedefs
+                // --------
+
+                typedef std::random_access_iterator_tag iterator_category;
+                typedef T                               value_type;
+                typedef std::ptrdiff_t                  difference_type;
+                typedef const T*                        pointer;
+                typedef const T&                        reference;
+
+            public:
+                friend bool operator == (const const_iterator& lhs, const const_iterator& rhs) {
+                    return lhs._i == rhs._i;}
+
+                friend bool operator != (const const_iterator& lhs, const const_iterator& rhs) {
+                    return !(lhs == rhs);}
+
+                friend bool operator < (const const_iterator& lhs, const const_iterator& rhs) {
+                    return lhs._i < rhs._i;}
+
+                friend const_iterator operator + (const_iterator lhs, difference_type rhs) {
+                    return lhs += rhs;}
+
+                friend const_iterator operator - (const_iterator lhs, difference_type rhs) {
+                    return lhs -= rhs;}
+
+                friend difference_type operator - (const const_iterator& lhs, const const_iterator& rhs) {
+                    return lhs._i - rhs._i;}
+
+            private:
+                // ----
+                // data
+                // ----
+
+                const SnapshotDeque* _d;
+                size_type            _i;
+
+            public:
+                const_iterator () :
+                        _d(0),
+                        _i(0)
+                    {}
+
+                const_iterator (const SnapshotDeque* d, size_type i) :
+                        _d(d),
+                        _i(i)
+                    {}
+
+                reference operator * () const {
+                    return (*_d)[_i];}
+
+                pointer operator -> () const {
+                    return std::addressof(**this);}
+
+                reference operator [] (difference_type d) const {
+                    return (*_d)[_i + d];}
+
+                const_iterator& operator ++ () {
+                    ++_i;
+                    return *this;}
+
+                const_iterator operator ++ (int) {
+                    const_iterator x = *this;
+                    ++_i;
+                    return x;}
+
+                const_iterator& operator -- () {
+                    --_i;
+                    return *this;}
+
+                const_iterator operator -- (int) {
+                    const_iterator x = *this;
+                    --_i;
+                    return x;}
+
+                const_iterator& operator += (difference_type d) {
+                    _i += d;
+                    return *this;}
+
+                const_iterator& operator -= (difference_type d) {
+                    _i -= d;
+                    return *this;}};
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        /**
+         * default constructor
+         */
+        SnapshotDeque () :
+                _offset(0),
+                _size(0)
+            {}
+
+        /**
+         * Shares every row of that: O(size() / S).
+         * @param that is a SnapshotDeque by reference
+         */
+        SnapshotDeque (const SnapshotDeque& that) :
+                _rows(that._rows),
+                _offset(that._offset),
+                _size(that._size) {
+            for (size_type r = 0; r != _rows.size(); ++r)
+                _rows[r]->refs.fetch_add(1, std::memory_order_relaxed);
+            assert(valid());}
+
+        // ----------
+        // destructor
+        // ----------
+
+        ~SnapshotDeque () {
+            clear();}
+
+        // ----------
+        // operator =
+        // ----------
+
+        SnapshotDeque& operator = (const SnapshotDeque& that) {
+            SnapshotDeque x(that);
+            swap(x);
+            return *this;}
+
+        // -----------
+        // operator []
+        // -----------
+
+        /**
+         * Clones the row holding element i first if it is shared.
+         * @return reference to element i
+         */
+        reference operator [] (size_type i) {
+            const size_type k = _offset + i;
+            make_unique(k / S);
+            return *_rows[k / S]->at(k % S);}
+
+        /**
+         * @return const_reference to element i
+         */
+        const_reference operator [] (size_type i) const {
+            const size_type k = _offset + i;
+            return *_rows[k / S]->at(k % S);}
+
+        // --
+        // at
+        // --
+
+        /**
+         * @throws out_of_range
+         */
+        const_reference at (size_type i) const {
+            if (i >= _size)
+                throw std::out_of_range("SnapshotDeque::at()");
+            return (*this)[i];}
+
+        // ----------
+        // back/front
+        // ----------
+
+        const_reference back () const {
+            return (*this)[_size - 1];}
+
+        const_reference front () const {
+            return (*this)[0];}
+
+        // ---------
+        // begin/end
+        // ---------
+
+        const_iterator begin () const {
+            return const_iterator(this, 0);}
+
+        const_iterator end () const {
+            return const_iterator(this, _size);}
+
+        // -----
+        // clear
+        // -----
+
+        void clear () {
+            for (size_type r = 0; r != _rows.size(); ++r)
+                release(_rows[r], lo(r), hi(r));
+            _rows.clear();
+            _offset = 0;
+            _size = 0;}
+
+        // -----
+        // empty
+        // -----
+
+        bool empty () const {
+            return !_size;}
+
+        // ---
+        // pop
+        // ---
+
+        /**
+         * Drops the back row when it empties; otherwise clones it first if shared.
+         */
+        void pop_back () {
+            const size_type k = _offset + _size - 1;
+            const size_type r = k / S;
+            if (k % S == 0 || _size == 1) {
+                release(_rows[r], lo(r), hi(r));
+                _rows.pop_back();
+                if (!--_size)
+                    _offset = 0;
+            } else {
+                make_unique(r);
+                _rows[r]->at(k % S)->~T();
+                --_size;}
+            assert(valid());}
+
+        /**
+         * Drops the front row when it empties; otherwise clones it first if shared.
+         */
+        void pop_front () {
+            if (_offset + 1 == S || _size == 1) {
+                release(_rows[0], lo(0), hi(0));
+                _rows.pop_front();
+                _offset = 0;
+                --_size;
+            } else {
+                make_unique(0);
+                _rows[0]->at(_offset)->~T();
+                ++_offset;
+                --_size;}
+            assert(valid());}
+
+        // ----
+        // push
+        // ----
+
+        void push_back (const_reference v) {
+            const size_type k = _offset + _size;
+            if (k / S == _rows.size()) {
+                std::unique_ptr<row> p(new row);
+                _rows.push_back(p.get());
+                try {
+                    new (p->at(k % S)) T(v);}
+                catch (...) {
+                    _rows.pop_back();
+                    throw;}
+                p.release();
+            } else {
+                make_unique(k / S);
+                new (_rows[k / S]->at(k % S)) T(v);}
+            ++_size;
+            assert(valid());}
+
+        void push_front (const_reference v) {
+            if (_offset == 0) {
+                std::unique_ptr<row> p(new row);
+                _rows.push_front(p.get());
+                try {
+                    new (p->at(S - 1)) T(v);}
+                catch (...) {
+                    _rows.pop_front();
+                    throw;}
+                p.release();
+                _offset = S - 1;
+            } else {
+                make_unique(0);
+                new (_rows[0]->at(_offset - 1)) T(v);
+                --_offset;}
+            ++_size;
+            assert(valid());}
+
+        // ----
+        // size
+        // ----
+
+        size_type size () const {
+            return _size;}
+
+        // --------
+        // snapshot
+        // --------
+
+        /**
+         * @return a read-only view of the current contents that shares every row
+         */
+        SnapshotDeque snapshot () const {
+            return *this;}
+
+        // ----
+        // swap
+        // ----
+
+        void swap (SnapshotDeque& that) {
+            _rows.swap(that._rows);
+            std::swap(_offset, that._offset);
+            std::swap(_size, that._size);}};
+
+template <typename T, std::size_t S>
+const typename SnapshotDeque<T, S>::size_type SnapshotDeque<T, S>::ROW_SIZE;
+
+#endif // SnapshotDeque_h
@@ -0,0 +1,340 @@
+// --------------------------
+// projects/deque/SoADeque.h
+// --------------------------
+
+#ifndef SoADeque_h
+#define SoADeque_h
+
+// --------
+// includes
+// --------
+
+#include <cassert>   // assert
+#include <cstddef>   // size_t
+#include <stdexcept> // out_of_range
+#include <tuple>     // get, tuple, tuple_element
+
+#include "BlockAllocator.h"
+#include "Deque.h"
+
+// --------------------
+// soa_column_allocator
+// --------------------
+
+/**
+ * An AlignedAllocator whose MyDeque rows hold S elements whatever the size
+ * of T, so that columns of different types split into rows at the same
+ * indices. Rows start on a cache line.
+ */
+template <typename T, std::size_t S>
+class soa_column_allocator : public AlignedAllocator<T> {
+    public:
+        template <typename U>
+        struct rebind {
+            typedef soa_column_allocator<U, S> other;};
+
+        soa_column_allocator () {}
+
+        template <typename U>
+        soa_column_allocator (const soa_column_allocator<U, S>&) {}};
+
+template <typename U, std::size_t S>
+struct deque_row_size< soa_column_allocator<U, S> > {
+    static const std::size_t value = S;};
+
+// -----------
+// soa_indices
+// -----------
+
+/**
+ * The list 0, 1, ..., N - 1 as a type, for expanding a pack of columns: what
+ * std::index_sequence does, which C++0x does not have.
+ */
+template <std::size_t... I>
+struct soa_indices {};
+
+template <std::size_t N, std::size_t... I>
+struct soa_make_indices : soa_make_indices<N - 1, N - 1, I...> {};
+
+template <std::size_t... I>
+struct soa_make_indices<0, I...> {
+    typedef soa_indices<I...> type;};
+
+// --------
+// SoADeque
+// --------
+
+/**
+ * A deque of records with fields of types Fs..., stored as a structure of
+ * arrays: each field is a column of its own, a MyDeque whose rows are ROW
+ * elements long, so row j of every column holds the same records and a scan
+ * of one field reads only that field's bytes. column<I>() gives read access
+ * to a whole column, for for_each_segment() and the like; the segments are
+ * contiguous, cache line aligned arrays of up to ROW elements, which a loop
+ * over them can vectorize.
+ *
+ * Records go in and out whole, at either end. A push that throws part way
+ * through takes back the fields it had already pushed.
+ */
+template <typename... Fs>
+class SoADeque {
+    static_assert(sizeof...(Fs) > 0, "a record needs at least one field");
+
+    public:
+        // --------
+        // typedefs
+        // --------
+
+        typedef std::tuple<Fs...> value_type;
+        typedef std::size_t       size_type;
+
+        //Records in each row of every column; long rows keep the hardware
+        //prefetcher streaming through a column scan.
+        const static size_type ROW = 1024;
+
+        template <std::size_t I>
+        using field_type = typename std::tuple_element<I, value_type>::type;
+
+        template <std::size_t I>
+        using column_type = MyDeque< field_type<I>, soa_column_allocator<field_type<I>, ROW> >;
+
+        typedef std::tuple<Fs&...>       reference;
+        typedef std::tuple<const Fs&...> const_reference;
+
+    private:
+        typedef typename soa_make_indices<sizeof...(Fs)>::type indices;
+
+        // ----
+        // data
+        // ----
+
+        std::tuple< MyDeque< Fs, soa_column_allocator<Fs, ROW> >... > _columns;
+
+    private:
+        // -----
+        // valid
+        // -----
+
+        template <std::size_t... I>
+        bool valid (soa_indices<I...>) const {
+            const size_type n = size();
+            const bool same[] = {(std::get<I>(_columns).size() == n)...};
+            for (bool b : same)
+                if (!b)
+                    return false;
+            return true;}
+
+        bool valid () const {
+            return valid(indices());}
+
+        /**
+         * Pushes field I of a record onto the back or front of column I and
+         * then the fields after it, popping column I again if a later one throws.
+         */
+        template <bool Front, std::size_t I, typename V, typename... Vs>
+        void push (const V& v, const Vs&... vs) {
+            column_type<I>& c = std::get<I>(_columns);
+            if (Front)
+                c.push_front(v);
+            else
+                c.push_back(v);
+            try {
+                push<Front, I + 1>(vs...);}
+            catch (...) {
+                if (Front)
+                    c.pop_front();
+                else
+                    c.pop_back();
+                throw;}}
+
+        template <bool Front, std::size_t I>
+        void push () {}
+
+        template <std::size_t... I>
+        void push_back (const value_type& v, soa_indices<I...>) {
+            push_back(std::get<I>(v)...);}
+
+        template <std::size_t... I>
+        void push_front (const value_type& v, soa_indices<I...>) {
+            push_front(std::get<I>(v)...);}
+
+        template <typename R, std::size_t... I>
+        R row (size_type i, soa_indices<I...>) const {
+            return R(const_cast<column_type<I>&>(std::get<I>(_columns))[i]...);}
+
+        template <std::size_t... I>
+        void pop_back (soa_indices<I...>) {
+            const int x[] = {(std::get<I>(_columns).pop_back(), 0)...};
+            static_cast<void>(x);}
+
+        template <std::size_t... I>
+        void pop_front (soa_indices<I...>) {
+            const int x[] = {(std::get<I>(_columns).pop_front(), 0)...};
+            static_cast<void>(x);}
+
+        template <std::size_t... I>
+        void clear (soa_indices<I...>) {
+            const int x[] = {(std::get<I>(_columns).clear(), 0)...};
+            static_cast<void>(x);}
+
+        template <std::size_t... I>
+        void swap (SoADeque& that, soa_indices<I...>) {
+            const int x[] = {(std::get<I>(_columns).swap(std::get<I>(that._columns)), 0)...};
+            static_cast<void>(x);}
+
+    public:
+        // -----------
+        // operator []
+        // -----------
+
+        /**
+         * @return the fields of record i, as a tuple of references
+         */
+        reference operator [] (size_type i) {
+            return row<reference>(i, indices());}
+
+        const_reference operator [] (size_type i) const {
+            return row<const_reference>(i, indices());}
+
+        // --
+        // at
+        // --
+
+        /**
+         * @throws out_of_range exception
+         */
+        reference at (size_type i) {
+            if (i >= size())
+                throw std::out_of_range("SoADeque::at()");
+            return (*this)[i];}
+
+        /**
+         * @throws out_of_range exception
+         */
+        const_reference at (size_type i) const {
+            if (i >= size())
+                throw std::out_of_range("SoADeque::at()");
+            return (*this)[i];}
+
+        // ----------
+        // back/front
+        // ----------
+
+        reference back () {
+            return (*this)[size() - 1];}
+
+        const_reference back () const {
+            return (*this)[size() - 1];}
+
+        reference front () {
+            return (*this)[0];}
+
+        const_reference front () const {
+            return (*this)[0];}
+
+        // -----
+        // clear
+        // -----
+
+        void clear () {
+            clear(indices());}
+
+        // ------
+        // column
+        // ------
+
+        /**
+         * @return column I, field I of every record in order
+         */
+        template <std::size_t I>
+        const column_type<I>& column () const {
+            return std::get<I>(_columns);}
+
+        // -----
+        // empty
+        // -----
+
+        bool empty () const {
+            return !size();}
+
+        // ----------------
+        // for_each_segment
+        // ----------------
+
+        /**
+         * Calls f(p, n) for each row of column I in order.
+         * @param f is called as f(const field_type<I>*, size_type)
+         */
+        template <std::size_t I, typename F>
+        void for_each_segment (F f) const {
+            std::get<I>(_columns).for_each_segment(f);}
+
+        // ---
+        // get
+        // ---
+
+        /**
+         * @return field I of record i
+         */
+        template <std::size_t I>
+        field_type<I>& get (size_type i) {
+            return std::get<I>(_columns)[i];}
+
+        template <std::size_t I>
+        const field_type<I>& get (size_type i) const {
+            return std::get<I>(_columns)[i];}
+
+        // ---
+        // pop
+        // ---
+
+        void pop_back () {
+            pop_back(indices());
+            assert(valid());}
+
+        void pop_front () {
+            pop_front(indices());
+            assert(valid());}
+
+        // ----
+        // push
+        // ----
+
+        /**
+         * Appends the record (v...).
+         */
+        void push_back (const Fs&... v) {
+            push<false, 0>(v...);
+            assert(valid());}
+
+        void push_back (const value_type& v) {
+            push_back(v, indices());}
+
+        /**
+         * Prepends the record (v...).
+         */
+        void push_front (const Fs&... v) {
+            push<true, 0>(v...);
+            assert(valid());}
+
+        void push_front (const value_type& v) {
+            push_front(v, indices());}
+
+        // ----
+        // size
+        // ----
+
+        size_type size () const {
+            return std::get<0>(_columns).size();}
+
+        // ----
+        // swap
+        // ----
+
+        void swap (SoADeque& that) {
+            swap(that, indices());}};
+
+template <typename... Fs>
+const typename SoADeque<Fs...>::size_type SoADeque<Fs...>::ROW;
+
+#endif // SoADeque_h
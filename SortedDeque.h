@@ -0,0 +1,462 @@
+// -----------------------------
+// projects/deque/SortedDeque.h
+// -----------------------------
+
+#ifndef SortedDeque_h
+#define SortedDeque_h
+
+// --------
+// includes
+// --------
+
+#include <algorithm>   // lower_bound, move, move_backward, upper_bound
+#include <cassert>     // assert
+#include <cstddef>     // size_t, ptrdiff_t
+#include <functional>  // less
+#include <iterator>    // bidirectional_iterator_tag
+#include <memory>      // addressof
+#include <new>         // placement new
+#include <type_traits> // aligned_storage
+#include <utility>     // move, swap
+
+#include "Deque.h"
+
+// ------------
+// sorted_block
+// ------------
+
+/**
+ * Up to S elements in order; [0, n) are live.
+ */
+template <typename T, std::size_t S>
+struct sorted_block {
+    std::size_t n;
+    typename std::aligned_storage<sizeof(T) * S, alignof(T)>::type data;
+
+    sorted_block () :
+            n(0)
+        {}
+
+    T* begin () {
+        return reinterpret_cast<T*>(&data);}
+
+    T* end () {
+        return begin() + n;}};
+
+// -----------
+// SortedDeque
+// -----------
+
+/**
+ * A deque that keeps its elements in Compare order. The elements live in
+ * blocks of up to S, each block partly filled, and the first key of every
+ * block is kept in a separate MyDeque so that a search binary-searches those
+ * keys and then one block. insert_sorted() shifts elements only inside the
+ * target block and splits it in two when it is full, so an ordered insert
+ * moves at most S elements plus one pointer per block. Inserting past the
+ * back or before the front, and popping either end, never split anything.
+ * Equal elements keep their insertion order.
+ */
+template <typename T, typename Compare = std::less<T>, std::size_t S = 64>
+class SortedDeque {
+    public:
+        // --------
+        // typedefs
+        // --------
+
+        typedef T                     value_type;
+        typedef Compare               value_compare;
+        typedef std::size_t           size_type;
+        typedef std::ptrdiff_t        difference_type;
+        typedef const T&              const_reference;
+        typedef sorted_block<T, S>    block;
+
+        //Largest number of elements in a block.
+        const static size_type BLOCK_SIZE = S;
+
+    private:
+        // ----
+        // data
+        // ----
+
+        MyDeque<block*> _blocks;
+        MyDeque<T>      _keys; // _keys[j] is the first element of _blocks[j]
+        size_type       _size;
+        Compare         _less;
+
+    private:
+        // -----
+        // valid
+        // -----
+
+        bool valid () const {
+            return (_blocks.size() == _keys.size()) && (_size >= _blocks.size());}
+
+        /**
+         * Inserts an empty block at j, with key as its first key.
+         */
+        block* add_block (size_type j, const T& key) {
+            block* b = new block;
+            try {
+                if (j == _blocks.size())
+                    _blocks.push_back(b);
+                else if (j == 0)
+                    _blocks.push_front(b);
+                else
+                    _blocks.insert(_blocks.begin() + j, b);
+                try {
+                    if (j == _keys.size())
+                        _keys.push_back(key);
+                    else if (j == 0)
+                        _keys.push_front(key);
+                    else
+                        _keys.insert(_keys.begin() + j, key);}
+                catch (...) {
+                    _blocks.erase(_blocks.begin() + j);
+                    throw;}}
+            catch (...) {
+                delete b;
+                throw;}
+            return b;}
+
+        /**
+         * Removes block j, which must be empty.
+         */
+        void remove_block (size_type j) {
+            assert(!_blocks[j]->n);
+            delete _blocks[j];
+            if (j == 0) {
+                _blocks.pop_front();
+                _keys.pop_front();}
+            else if (j + 1 == _blocks.size()) {
+                _blocks.pop_back();
+                _keys.pop_back();}
+            else {
+                _blocks.erase(_blocks.begin() + j);
+                _keys.erase(_keys.begin() + j);}}
+
+        /**
+         * Moves the upper half of the full block j into a new block after it.
+         */
+        void split_block (size_type j) {
+            block* b = _blocks[j];
+            assert(b->n == S);
+            T* mid = b->begin() + S / 2;
+            block* c = add_block(j + 1, *mid);
+            T* p = c->begin();
+            for (T* q = mid; q != b->end(); ++q, ++p, ++c->n)
+                new (p) T(std::move(*q));
+            for (T* q = mid; q != b->end(); ++q)
+                q->~T();
+            b->n = S / 2;}
+
+        /**
+         * Removes element i of block j, closing the gap within the block.
+         */
+        void erase_in_block (size_type j, size_type i) {
+            block* b = _blocks[j];
+            std::move(b->begin() + i + 1, b->end(), b->begin() + i);
+            (b->end() - 1)->~T();
+            --b->n;
+            --_size;
+            if (!b->n)
+                remove_block(j);
+            else if (!i)
+                _keys[j] = *b->begin();}
+
+    public:
+        // --------------
+        // const_iterator
+        // --------------
+
+        /**
+         * Walks the blocks in order; only const access, so the order can't be broken.
+         */
+        class const_iterator {
+            public:
+                // --------
+                // typedefs
+                // --------
+
+                typedef std::bidirectional_iterator_tag iterator_category;
+                typedef T                               value_type;
+                typedef std::ptrdiff_t                  difference_type;
+                typedef const T*                        pointer;
+                typedef const T&                        reference;
+
+            public:
+                friend bool operator == (const const_iterator& lhs, const const_iterator& rhs) {
+                    return (lhs._j == rhs._j) && (lhs._i == rhs._i);}
+
+                friend bool operator != (const const_iterator& lhs, const const_iterator& rhs) {
+                    return !(lhs == rhs);}
+
+            private:
+                friend class SortedDeque;
+
+                // ----
+                // data
+                // ----
+
+                const SortedDeque* _d;
+                size_type          _j; // block
+                size_type          _i; // element within the block
+
+            public:
+                const_iterator () :
+                        _d(0),
+                        _j(0),
+                        _i(0)
+                    {}
+
+                const_iterator (const SortedDeque* d, size_type j, size_type i) :
+                        _d(d),
+                        _j(j),
+                        _i(i)
+                    {}
+
+                reference operator * () const {
+                    return _d->_blocks[_j]->begin()[_i];}
+
+                pointer operator -> () const {
+                    return std::addressof(**this);}
+
+                const_iterator& operator ++ () {
+                    if (++_i == _d->_blocks[_j]->n) {
+                        ++_j;
+                        _i = 0;}
+                    return *this;}
+
+                const_iterator operator ++ (int) {
+                    const_iterator x = *this;
+                    ++(*this);
+                    return x;}
+
+                const_iterator& operator -- () {
+                    if (!_i)
+                        _i = _d->_blocks[--_j]->n;
+                    --_i;
+                    return *this;}
+
+                const_iterator operator -- (int) {
+                    const_iterator x = *this;
+                    --(*this);
+                    return x;}};
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        /**
+         * @param c is a Compare by reference -- defaulted
+         */
+        explicit SortedDeque (const Compare& c = Compare()) :
+                _size(0),
+                _less(c)
+            {}
+
+        /**
+         * copy constructor; the copy's blocks are full except the last
+         */
+        SortedDeque (const SortedDeque& that) :
+                _size(0),
+                _less(that._less) {
+            try {
+                for (const_iterator b = that.begin(), e = that.end(); b != e; ++b)
+                    insert_sorted(*b);}
+            catch (...) {
+                clear();
+                throw;}}
+
+        // ----------
+        // destructor
+        // ----------
+
+        ~SortedDeque () {
+            clear();}
+
+        // ----------
+        // operator =
+        // ----------
+
+        SortedDeque& operator = (const SortedDeque& that) {
+            SortedDeque x(that);
+            swap(x);
+            return *this;}
+
+        // ----------
+        // back/front
+        // ----------
+
+        const_reference back () const {
+            block* b = _blocks.back();
+            return b->begin()[b->n - 1];}
+
+        const_reference front () const {
+            return _blocks.front()->begin()[0];}
+
+        // ---------
+        // begin/end
+        // ---------
+
+        const_iterator begin () const {
+            return const_iterator(this, 0, 0);}
+
+        const_iterator end () const {
+            return const_iterator(this, _blocks.size(), 0);}
+
+        // -----
+        // clear
+        // -----
+
+        void clear () {
+            for (size_type j = 0; j != _blocks.size(); ++j) {
+                block* b = _blocks[j];
+                for (T* p = b->begin(); p != b->end(); ++p)
+                    p->~T();
+                delete b;}
+            _blocks.clear();
+            _keys.clear();
+            _size = 0;}
+
+        // -----
+        // empty
+        // -----
+
+        bool empty () const {
+            return !_size;}
+
+        // -----
+        // erase
+        // -----
+
+        /**
+         * @param pos is a const_iterator to an element
+         * @return const_iterator to the element after it
+         */
+        const_iterator erase (const_iterator pos) {
+            const size_type j = pos._j;
+            const size_type n = _blocks.size();
+            erase_in_block(j, pos._i);
+            if (_blocks.size() != n || pos._i == _blocks[j]->n)
+                return const_iterator(this, _blocks.size() == n ? j + 1 : j, 0);
+            return pos;}
+
+        // ----
+        // find
+        // ----
+
+        /**
+         * @return const_iterator to the first element equivalent to v, or end()
+         */
+        const_iterator find (const T& v) const {
+            const const_iterator p = lower_bound(v);
+            return (p == end() || _less(v, *p)) ? end() : p;}
+
+        // -------------
+        // insert_sorted
+        // -------------
+
+        /**
+         * Inserts v after the elements that are not greater than it.
+         * @return const_iterator to the new element
+         */
+        const_iterator insert_sorted (const T& v) {
+            if (_blocks.empty()) {
+                block* b = add_block(0, v);
+                new (b->begin()) T(v);
+                b->n = 1;
+                ++_size;
+                return begin();}
+            size_type j = std::upper_bound(_keys.begin(), _keys.end(), v, _less) - _keys.begin();
+            j = j ? j - 1 : 0;
+            block* b = _blocks[j];
+            size_type i = std::upper_bound(b->begin(), b->end(), v, _less) - b->begin();
+            if (b->n == S) {
+                if (i == S && j + 1 == _blocks.size()) {
+                    b = add_block(++j, v);
+                    i = 0;
+                } else if (i == 0 && j == 0)
+                    b = add_block(0, v);
+                else {
+                    split_block(j);
+                    if (i > S / 2) {
+                        b = _blocks[++j];
+                        i -= S / 2;}}}
+            T* p = b->begin() + i;
+            if (p == b->end())
+                new (p) T(v);
+            else {
+                T x(v);
+                new (b->end()) T(std::move(*(b->end() - 1)));
+                std::move_backward(p, b->end() - 1, b->end());
+                *p = std::move(x);}
+            ++b->n;
+            ++_size;
+            if (!i)
+                _keys[j] = *p;
+            assert(valid());
+            return const_iterator(this, j, i);}
+
+        // -----------
+        // lower_bound
+        // -----------
+
+        /**
+         * @return const_iterator to the first element not less than v
+         */
+        const_iterator lower_bound (const T& v) const {
+            const size_type k = std::lower_bound(_keys.begin(), _keys.end(), v, _less) - _keys.begin();
+            if (!k)
+                return begin();
+            block* b = _blocks[k - 1];
+            const size_type i = std::lower_bound(b->begin(), b->end(), v, _less) - b->begin();
+            return (i == b->n) ? const_iterator(this, k, 0) : const_iterator(this, k - 1, i);}
+
+        // ---
+        // pop
+        // ---
+
+        void pop_back () {
+            erase_in_block(_blocks.size() - 1, _blocks.back()->n - 1);}
+
+        void pop_front () {
+            erase_in_block(0, 0);}
+
+        // ----
+        // size
+        // ----
+
+        size_type size () const {
+            return _size;}
+
+        // ----
+        // swap
+        // ----
+
+        void swap (SortedDeque& that) {
+            _blocks.swap(that._blocks);
+            _keys.swap(that._keys);
+            std::swap(_size, that._size);
+            std::swap(_less, that._less);}
+
+        // -----------
+        // upper_bound
+        // -----------
+
+        /**
+         * @return const_iterator to the first element greater than v
+         */
+        const_iterator upper_bound (const T& v) const {
+            const size_type k = std::upper_bound(_keys.begin(), _keys.end(), v, _less) - _keys.begin();
+            if (!k)
+                return begin();
+            block* b = _blocks[k - 1];
+            const size_type i = std::upper_bound(b->begin(), b->end(), v, _less) - b->begin();
+            return (i == b->n) ? const_iterator(this, k, 0) : const_iterator(this, k - 1, i);}};
+
+template <typename T, typename Compare, std::size_t S>
+const typename SortedDeque<T, Compare, S>::size_type SortedDeque<T, Compare, S>::BLOCK_SIZE;
+
+#endif // SortedDeque_h
@@ -19,13 +19,67 @@ To test the program:
 // --------
 
 #include <algorithm> // equal
+#include <atomic>    // atomic
+#include <chrono>    // milliseconds
+#include <cstdint>   // uintptr_t
+#include <cstdio>    // fileno, tmpfile
 #include <cstring>   // strcmp
 #include <deque>     // deque
+#include <functional> // greater
+#include <iterator>  // back_inserter
+#include <memory>    // unique_ptr
+#include <numeric>   // accumulate
+#include <random>    // mt19937
+#include <set>       // multiset
 #include <sstream>   // ostringstream
 #include <stdexcept> // invalid_argument
 #include <string>    // ==
+#include <thread>    // thread
+#include <tuple>     // get, tuple
+#include <vector>    // vector
 #include <gtest/gtest.h>
+#include <fcntl.h>    // O_*
+#include <sys/mman.h> // shm_open
+#include <sys/stat.h> // stat
+#include <sys/wait.h> // waitpid
+#include <unistd.h>   // fork, getpid, lseek, unlink, _exit
+#if __cplusplus >= 202002L
+#include <latch>     // latch
+#include "AsyncDequeChannel.h"
+#endif
+#include "BlockAllocator.h"
+#include "CompressedDeque.h"
 #include "Deque.h"
+#include "DequeSort.h"
+#include "MappedDeque.h"
+#include "ShardedDeque.h"
+#include "SharedDeque.h"
+#include "SlidingWindow.h"
+#include "SnapshotDeque.h"
+#include "SoADeque.h"
+#include "SortedDeque.h"
+#include "TieredDeque.h"
+
+// -----------------
+// CountingAllocator
+// -----------------
+
+int counting_allocations = 0;
+
+template <typename T>
+struct CountingAllocator : std::allocator<T> {
+    template <typename U>
+    struct rebind {
+        typedef CountingAllocator<U> other;};
+
+    CountingAllocator () {}
+
+    template <typename U>
+    CountingAllocator (const CountingAllocator<U>&) {}
+
+    T* allocate (std::size_t n) {
+        ++counting_allocations;
+        return std::allocator<T>::allocate(n);}};
 
 // ---------
 // TestDeque
@@ -60,7 +114,7 @@ protected:
 };
 
 using testing::Types;
-typedef Types<std::deque<int>, MyDeque<int>, std::deque<short>, MyDeque<short>, std::deque<long>, MyDeque<long>, std::deque<unsigned>, MyDeque<unsigned> > Implementations;
+typedef Types<std::deque<int>, MyDeque<int>, std::deque<short>, MyDeque<short>, std::deque<long>, MyDeque<long>, std::deque<unsigned>, MyDeque<unsigned>, MyDeque<int, std::allocator<int>, 12>, MyDeque<int, AlignedAllocator<int> >, MyDeque<int, HugePageAllocator<int> >, MyDeque<int, std::allocator<int>, 0, deque_incremental_growth> > Implementations;
 TYPED_TEST_CASE(DequeTest, Implementations);
 
 TYPED_TEST(DequeTest, valConstructor_1){
@@ -521,3 +575,1767 @@ TYPED_TEST(DequeTest, copy_constructor){
     ASSERT_EQ(this->aDequeLHS.front(), this->blah().front());
     ASSERT_EQ(this->aDequeLHS.back(), this->blah().back()); 
 }
+
+TYPED_TEST(DequeTest, reverse_iteration){
+    for (int i = 0; i < 40; ++i) {
+        this->aDequeLHS.push_back(40 + i);
+        this->aDequeLHS.push_front(39 - i);}
+    std::vector<int> vec(this->aDequeLHS.begin(), this->aDequeLHS.end());
+    std::reverse(vec.begin(), vec.end());
+    EXPECT_TRUE(std::equal(this->aDequeLHS.rbegin(), this->aDequeLHS.rend(), vec.begin()));
+    const TypeParam& c = this->aDequeLHS;
+    EXPECT_TRUE(std::equal(c.rbegin(), c.rend(), vec.begin()));
+    EXPECT_EQ(c.rend() - c.rbegin(), 80);
+    std::sort(this->aDequeLHS.rbegin(), this->aDequeLHS.rend());
+    EXPECT_EQ(this->aDequeLHS.front(), 79);
+    EXPECT_EQ(this->aDequeLHS.back(), 0);
+    this->cit = this->aDequeLHS.begin();
+    EXPECT_TRUE(this->cit == this->aDequeLHS.begin());
+    EXPECT_TRUE(this->aDequeLHS.cend() == this->aDequeLHS.end());
+}
+
+// -------------
+// inline buffer
+// -------------
+
+TEST(InlineDequeTest, small_no_allocation) {
+    counting_allocations = 0;
+    MyDeque<int, CountingAllocator<int>, 12> x;
+    for (int i = 0; i < 12; ++i)
+        x.push_back(i);
+    ASSERT_EQ(counting_allocations, 0);
+    for (int i = 0; i < 12; ++i)
+        ASSERT_EQ(x[i], i);
+}
+
+TEST(InlineDequeTest, small_no_allocation_front) {
+    counting_allocations = 0;
+    MyDeque<int, CountingAllocator<int>, 12> x;
+    for (int i = 0; i < 6; ++i) {
+        x.push_front(i);
+        x.push_back(i);}
+    ASSERT_EQ(counting_allocations, 0);
+    ASSERT_EQ(x.front(), 5);
+    ASSERT_EQ(x.back(), 5);
+}
+
+TEST(InlineDequeTest, queue_no_allocation) {
+    counting_allocations = 0;
+    MyDeque<int, CountingAllocator<int>, 12> x;
+    for (int i = 0; i < 1000; ++i) {
+        x.push_back(i);
+        if (x.size() > 10)
+            x.pop_front();}
+    ASSERT_EQ(counting_allocations, 0);
+    ASSERT_EQ(x.front(), 990);
+    ASSERT_EQ(x.back(), 999);
+}
+
+TEST(InlineDequeTest, spill) {
+    MyDeque<int, std::allocator<int>, 12> x;
+    for (int i = 0; i < 100; ++i)
+        x.push_back(i);
+    for (int i = 0; i < 100; ++i)
+        x.push_front(-i);
+    ASSERT_EQ(x.size(), 200u);
+    ASSERT_EQ(x[0], -99);
+    ASSERT_EQ(x[199], 99);
+    while (x.size() > 3)
+        x.pop_back();
+    ASSERT_EQ(x.back(), -97);
+    MyDeque<int, std::allocator<int>, 12> y(x);
+    ASSERT_TRUE(x == y);
+}
+
+TEST(InlineDequeTest, swap_move_only) {
+    MyDeque<std::unique_ptr<int>, std::allocator<std::unique_ptr<int> >, 12> x, y;
+    for (int i = 0; i < 3; ++i)
+        x.push_back(std::unique_ptr<int>(new int(i)));
+    for (int i = 0; i < 50; ++i)
+        y.push_front(std::unique_ptr<int>(new int(-i)));
+    x.swap(y);
+    ASSERT_EQ(x.size(), 50u);
+    ASSERT_EQ(y.size(), 3u);
+    ASSERT_EQ(*x.front(), -49);
+    ASSERT_EQ(*y.back(), 2);
+    x.swap(x);
+    ASSERT_EQ(*x.back(), 0);
+}
+
+TEST(InlineDequeTest, swap_spilled) {
+    MyDeque<int, std::allocator<int>, 12> x, y;
+    for (int i = 0; i < 200; ++i) {
+        x.push_back(i);
+        y.push_back(-i);}
+    // the inline rows hold the first elements
+    for (int i = 0; i < 100; ++i) {
+        x.pop_front();
+        y.pop_front();}
+    const int* p = &x[0];
+    const int* q = &y[99];
+    x.swap(y);
+    ASSERT_EQ(&y[0], p);
+    ASSERT_EQ(&x[99], q);
+    ASSERT_EQ(x[99], -199);
+    ASSERT_EQ(y[0], 100);
+}
+
+// ------
+// layout
+// ------
+
+TEST(LayoutDequeTest, footprint) {
+    ASSERT_EQ(sizeof(MyDeque<int>), 4 * sizeof(void*));
+    ASSERT_EQ(sizeof(MyDeque<int>::iterator), 2 * sizeof(void*));
+    ASSERT_EQ(sizeof(MyDeque<int>::const_iterator), 2 * sizeof(void*));
+}
+
+TEST(LayoutDequeTest, random_access) {
+    MyDeque<int> x;
+    for (int i = 0; i < 100; ++i)
+        x.push_front(99 - i);
+    MyDeque<int>::iterator b = x.begin();
+    ASSERT_EQ(x.end() - b, 100);
+    ASSERT_EQ(*(b + 37), 37);
+    ASSERT_EQ(*(x.end() - 1), 99);
+    ASSERT_EQ(b[64], 64);
+    ASSERT_TRUE(b + 3 < b + 4);
+    ASSERT_EQ(*std::lower_bound(x.begin(), x.end(), 73), 73);
+}
+
+TEST(LayoutDequeTest, matches_std_deque) {
+    MyDeque<int> x;
+    std::deque<int> y;
+    unsigned r = 1;
+    for (int i = 0; i < 20000; ++i) {
+        r = r * 1103515245 + 12345;
+        switch ((r >> 16) % 6) {
+            case 0: case 1:
+                x.push_back(i);
+                y.push_back(i);
+                break;
+            case 2:
+                x.push_front(i);
+                y.push_front(i);
+                break;
+            case 3:
+                if (!y.empty()) {
+                    x.pop_back();
+                    y.pop_back();}
+                break;
+            case 4:
+                if (!y.empty()) {
+                    x.pop_front();
+                    y.pop_front();}
+                break;
+            default:
+                if (!y.empty()) {
+                    std::size_t k = (r >> 8) % y.size();
+                    x.insert(x.begin() + k, i);
+                    y.insert(y.begin() + k, i);
+                    k = (r >> 4) % y.size();
+                    x.erase(x.begin() + k);
+                    y.erase(y.begin() + k);}}
+        ASSERT_EQ(x.size(), y.size());}
+    ASSERT_TRUE(std::equal(y.begin(), y.end(), x.begin()));
+}
+
+TEST(LayoutDequeTest, move_assign) {
+    MyDeque<std::string> x(3, "old");
+    MyDeque<std::string> y;
+    for (int i = 0; i < 1000; ++i)
+        y.push_back(std::to_string(i));
+    const std::string* p = &y[0];
+    const std::string* q = &y[999];
+    x = std::move(y);
+    ASSERT_TRUE(y.empty());
+    ASSERT_EQ(x.size(), 1000u);
+    ASSERT_EQ(&x[0], p);
+    ASSERT_EQ(&x[999], q);
+    ASSERT_EQ(x[500], "500");
+    y = std::move(x);
+    y = std::move(y);
+    ASSERT_EQ(y.size(), 1000u);
+    y.push_back("1000");
+    x.push_back("x");
+    ASSERT_EQ(x.size(), 1u);
+    MyDeque<std::unique_ptr<int>, std::allocator<std::unique_ptr<int> >, 12> u, v;
+    u.push_back(std::unique_ptr<int>(new int(7)));
+    v = std::move(u);
+    ASSERT_TRUE(u.empty());
+    ASSERT_EQ(*v.front(), 7);
+}
+
+struct copy_counter {
+    static int copies;
+    int v;
+    copy_counter (int v) : v(v) {}
+    copy_counter (const copy_counter& that) : v(that.v) {
+        ++copies;}
+    copy_counter (copy_counter&&) = default;
+    copy_counter& operator = (const copy_counter& that) {
+        ++copies;
+        v = that.v;
+        return *this;}
+    copy_counter& operator = (copy_counter&&) = default;};
+
+int copy_counter::copies = 0;
+
+TEST(LayoutDequeTest, insert_moves) {
+    for (int k = 0; k <= 40; ++k) {
+        MyDeque<copy_counter> x;
+        for (int i = 0; i < 40; ++i)
+            x.push_back(copy_counter(i));
+        copy_counter::copies = 0;
+        ASSERT_EQ(x.insert(x.begin() + k, copy_counter(-1))->v, -1);
+        ASSERT_EQ(copy_counter::copies, 1);
+        ASSERT_EQ(x.size(), 41u);
+        for (int i = 0; i < 41; ++i)
+            ASSERT_EQ(x[i].v, (i < k) ? i : (i == k) ? -1 : i - 1);}
+}
+
+TEST(LayoutDequeTest, erase_moves) {
+    for (int k = 0; k < 40; ++k) {
+        MyDeque<copy_counter> x;
+        for (int i = 0; i < 40; ++i)
+            x.push_back(copy_counter(i));
+        copy_counter::copies = 0;
+        const MyDeque<copy_counter>::iterator p = x.erase(x.begin() + k);
+        ASSERT_EQ(p - x.begin(), k);
+        ASSERT_EQ(copy_counter::copies, 0);
+        ASSERT_EQ(x.size(), 39u);
+        for (int i = 0; i < 39; ++i)
+            ASSERT_EQ(x[i].v, (i < k) ? i : i + 1);}
+    MyDeque<std::unique_ptr<int> > y;
+    for (int i = 0; i < 10; ++i)
+        y.push_back(std::unique_ptr<int>(new int(i)));
+    y.erase(y.begin() + 3);
+    y.erase(y.begin() + 6);
+    ASSERT_EQ(*y[3], 4);
+    ASSERT_EQ(*y[6], 8);
+}
+
+// -------------
+// serialization
+// -------------
+
+TEST(SerializeDequeTest, save_load) {
+    MyDeque<long> x;
+    for (long i = 0; i < 1000; ++i)
+        x.push_front(i);
+    std::stringstream s;
+    x.save(s);
+    MyDeque<long> y;
+    y.push_back(7);
+    y.load(s);
+    ASSERT_TRUE(s);
+    ASSERT_TRUE(x == y);
+    y.push_front(-1);
+    y.push_back(-2);
+    ASSERT_EQ(y.size(), 1002u);
+}
+
+TEST(SerializeDequeTest, load_empty) {
+    MyDeque<int> x;
+    std::stringstream s;
+    x.save(s);
+    MyDeque<int> y(3, 3);
+    y.load(s);
+    ASSERT_TRUE(s);
+    ASSERT_TRUE(y.empty());
+}
+
+TEST(SerializeDequeTest, load_bad_header) {
+    std::stringstream s("not a deque at all");
+    MyDeque<int> y(3, 3);
+    y.load(s);
+    ASSERT_FALSE(s);
+    ASSERT_TRUE(y.empty());
+}
+
+TEST(SerializeDequeTest, load_short) {
+    MyDeque<int> x(100, 1);
+    std::stringstream s;
+    x.save(s);
+    std::string bytes = s.str();
+    std::stringstream t(bytes.substr(0, bytes.size() - 4));
+    MyDeque<int> y;
+    y.load(t);
+    ASSERT_FALSE(t);
+    ASSERT_TRUE(y.empty());
+}
+
+template <typename T>
+struct LimitedAllocator : std::allocator<T> {
+    template <typename U>
+    struct rebind {
+        typedef LimitedAllocator<U> other;};
+
+    LimitedAllocator () {}
+
+    template <typename U>
+    LimitedAllocator (const LimitedAllocator<U>&) {}
+
+    T* allocate (std::size_t n) {
+        if (n > (1 << 20))
+            throw std::bad_alloc();
+        return std::allocator<T>::allocate(n);}};
+
+TEST(SerializeDequeTest, corrupt_size) {
+    // more than max_size(), enough to wrap a count of rows, and more than can be allocated
+    const std::uint64_t sizes[] = {~std::uint64_t(0), std::uint64_t(1) << 63, std::uint64_t(1) << 40};
+    for (std::uint64_t n : sizes) {
+        deque_header h;
+        std::memcpy(h.magic, "MYDQ", 4);
+        h.value_size = sizeof(char);
+        h.size = n;
+        std::stringstream s(std::string(reinterpret_cast<const char*>(&h), sizeof(h)) + "abc");
+        MyDeque<char, LimitedAllocator<char> > y(3, 'x');
+        y.load(s);
+        ASSERT_FALSE(s);
+        ASSERT_TRUE(y.empty());
+        y.push_back('a');
+        ASSERT_EQ(y.size(), 1u);}
+    MyDeque<int> x(10, 1);
+    std::FILE* f = std::tmpfile();
+    ASSERT_TRUE(f != 0);
+    x.write_to(fileno(f));
+    deque_header h;
+    std::memcpy(h.magic, "MYDQ", 4);
+    h.value_size = sizeof(int);
+    h.size = 11;
+    ASSERT_EQ(pwrite(fileno(f), &h, sizeof(h), 0), ssize_t(sizeof(h)));
+    ASSERT_EQ(lseek(fileno(f), 0, SEEK_SET), 0);
+    MyDeque<int> y(3, 3);
+    ASSERT_THROW(y.read_from(fileno(f)), std::runtime_error);
+    ASSERT_TRUE(y.empty());
+    std::fclose(f);
+}
+
+TEST(SerializeDequeTest, write_read_fd) {
+    MyDeque<int, std::allocator<int>, 12> x;
+    for (int i = 0; i < 10000; ++i)
+        x.push_back(i);
+    std::FILE* f = std::tmpfile();
+    ASSERT_TRUE(f != 0);
+    x.write_to(fileno(f));
+    ASSERT_EQ(lseek(fileno(f), 0, SEEK_SET), 0);
+    MyDeque<int, std::allocator<int>, 12> y;
+    y.read_from(fileno(f));
+    ASSERT_TRUE(x == y);
+    ASSERT_EQ(lseek(fileno(f), 0, SEEK_SET), 0);
+    MyDeque<short> z;
+    ASSERT_THROW(z.read_from(fileno(f)), std::runtime_error);
+    std::fclose(f);
+}
+
+// -----------
+// MappedDeque
+// -----------
+
+class MappedDequeTest : public testing::Test {
+protected:
+    virtual void SetUp() {
+        char name[] = "/tmp/MappedDequeXXXXXX";
+        int fd = mkstemp(name);
+        close(fd);
+        unlink(name);
+        path = name;}
+
+    virtual void TearDown() {
+        unlink(path.c_str());}
+
+    std::string path;
+};
+
+TEST_F(MappedDequeTest, reopen) {
+    {
+    MappedDeque<long> x(path);
+    for (long i = 0; i < 10000; ++i)
+        x.push_back(i);
+    for (long i = 1; i <= 100; ++i)
+        x.push_front(-i);
+    }
+    {
+    MappedDeque<long> x(path);
+    ASSERT_EQ(x.size(), 10100u);
+    ASSERT_EQ(x.front(), -100);
+    ASSERT_EQ(x.back(), 9999);
+    ASSERT_EQ(x[5100], 5000);
+    x.pop_front();
+    x.push_back(10000);
+    x.flush();
+    }
+    MappedDeque<long> x(path);
+    ASSERT_EQ(x.size(), 10100u);
+    ASSERT_EQ(x.front(), -99);
+    ASSERT_EQ(x.back(), 10000);
+}
+
+TEST_F(MappedDequeTest, streaming_bounded) {
+    MappedDeque<int> x(path);
+    for (int i = 0; i < 1000000; ++i) {
+        x.push_back(i);
+        if (x.size() > 1000)
+            x.pop_front();}
+    ASSERT_EQ(x.front(), 999000);
+    ASSERT_LT(x.file_size(), 1u << 20);
+}
+
+TEST_F(MappedDequeTest, popped_rows_punched) {
+    const std::size_t row = deque_row_size< MappedFileAllocator<long> >::value;
+    ASSERT_EQ(row * sizeof(long), std::size_t(deque_file_arena::PAGE));
+    MappedDeque<long> x(path);
+    for (long i = 0; i < long(200 * row); ++i)
+        x.push_back(i);
+    x.flush();
+    struct stat before, after;
+    ASSERT_EQ(stat(path.c_str(), &before), 0);
+    for (std::size_t i = 0; i != 150 * row; ++i)
+        x.pop_front();
+    x.flush();
+    ASSERT_EQ(stat(path.c_str(), &after), 0);
+    // st_blocks counts 512 byte blocks
+    ASSERT_LE(after.st_blocks + 140 * 8, before.st_blocks);
+    for (long i = 0; i < long(100 * row); ++i)
+        x.push_back(i);
+    ASSERT_EQ(x.front(), long(150 * row));
+    ASSERT_EQ(x.back(), long(100 * row) - 1);
+    ASSERT_EQ(x.size(), 150 * row);
+}
+
+TEST_F(MappedDequeTest, wrong_type) {
+    {
+    MappedDeque<int> x(path);
+    x.push_back(1);
+    }
+    ASSERT_THROW(MappedDeque<double> y(path), std::runtime_error);
+}
+
+// -------------
+// SnapshotDeque
+// -------------
+
+TEST(SnapshotDequeTest, snapshot_is_unchanged) {
+    SnapshotDeque<std::string, 4> x;
+    for (int i = 0; i < 50; ++i)
+        x.push_back(std::to_string(i));
+    SnapshotDeque<std::string, 4> y = x.snapshot();
+    x.pop_front();
+    x.pop_back();
+    x[10] = "ten";
+    x.push_front("front");
+    x.push_back("back");
+    ASSERT_EQ(y.size(), 50u);
+    for (int i = 0; i < 50; ++i)
+        ASSERT_EQ(y[i], std::to_string(i));
+    ASSERT_EQ(x.size(), 50u);
+    ASSERT_EQ(x.front(), "front");
+    ASSERT_EQ(x[11], "ten");
+    ASSERT_EQ(x[12], "12");
+    ASSERT_EQ(x.back(), "back");
+}
+
+TEST(SnapshotDequeTest, unchanged_rows_are_shared) {
+    SnapshotDeque<int, 8> x;
+    for (int i = 0; i < 800; ++i)
+        x.push_back(i);
+    const SnapshotDeque<int, 8> y = x.snapshot();
+    const SnapshotDeque<int, 8>& cx = x;
+    ASSERT_EQ(&cx[400], &y[400]);
+    x[0] = -1;
+    ASSERT_EQ(&cx[400], &y[400]);
+    ASSERT_NE(&cx[0], &y[0]);
+    ASSERT_EQ(y[0], 0);
+}
+
+TEST(SnapshotDequeTest, drain_and_refill) {
+    SnapshotDeque<std::string, 4> x;
+    for (int i = 0; i < 10; ++i)
+        x.push_front(std::to_string(i));
+    SnapshotDeque<std::string, 4> y(x);
+    while (!x.empty())
+        x.pop_back();
+    x.push_back("a");
+    ASSERT_EQ(x.size(), 1u);
+    ASSERT_EQ(y.front(), "9");
+    ASSERT_EQ(y.back(), "0");
+    ASSERT_TRUE(std::equal(y.begin(), y.end(), SnapshotDeque<std::string, 4>(y).begin()));
+}
+
+TEST(SnapshotDequeTest, readers_on_other_threads) {
+    SnapshotDeque<long, 16> x;
+    for (long i = 0; i < 1000; ++i)
+        x.push_back(i);
+    std::vector<std::thread> readers;
+    std::vector<int> ok(4, 0);
+    for (int t = 0; t < 4; ++t) {
+        SnapshotDeque<long, 16> snap = x.snapshot();
+        const long expected = 50 * std::accumulate(snap.begin(), snap.end(), 0L);
+        readers.push_back(std::thread([snap, expected, &ok, t] () {
+            long sum = 0;
+            for (int pass = 0; pass < 50; ++pass)
+                for (SnapshotDeque<long, 16>::const_iterator b = snap.begin(); b != snap.end(); ++b)
+                    sum += *b;
+            ok[t] = (sum == expected);}));
+        for (long i = 0; i < 500; ++i) {
+            x.pop_front();
+            x.push_back(-i);
+            x[i % x.size()] = 7;}}
+    for (std::size_t t = 0; t < readers.size(); ++t)
+        readers[t].join();
+    ASSERT_EQ(std::count(ok.begin(), ok.end(), 1), 4);
+}
+
+// ------
+// splice
+// ------
+
+TEST(SpliceDequeTest, splice_back_hands_over_rows) {
+    const std::size_t B = MyDeque<int>::INNER_SIZE;
+    int handed_over = 0;
+    for (std::size_t s = 0; s != B; ++s) {
+        MyDeque<int> x;
+        for (int i = 0; i < 3000; ++i)
+            x.push_back(i);
+        MyDeque<int> y;
+        for (int i = 0; i < 1000 + int(s); ++i)
+            y.push_back(3000 + i - int(s));
+        for (std::size_t i = 0; i != s; ++i)
+            y.pop_front();
+        std::vector<const int*> before;
+        for (std::size_t i = B; i != y.size(); ++i)
+            before.push_back(&y[i]);
+        x.splice_back(std::move(y));
+        ASSERT_TRUE(y.empty());
+        ASSERT_EQ(x.size(), 4000u);
+        for (int i = 0; i < 4000; ++i)
+            ASSERT_EQ(x[i], i);
+        bool same = true;
+        for (std::size_t i = 0; i != before.size(); ++i)
+            same = same && (&x[3000 + B + i] == before[i]);
+        handed_over += same;
+        y.push_back(1);
+        ASSERT_EQ(y.size(), 1u);}
+    ASSERT_EQ(handed_over, 1);
+}
+
+TEST(SpliceDequeTest, splice_front_hands_over_rows) {
+    const std::size_t B = MyDeque<int>::INNER_SIZE;
+    int handed_over = 0;
+    for (std::size_t s = 0; s != B; ++s) {
+        MyDeque<int> x;
+        for (int i = 1000; i < 4000; ++i)
+            x.push_back(i);
+        MyDeque<int> y;
+        for (int i = 0; i < 1000 + int(s); ++i)
+            y.push_back(i - int(s));
+        for (std::size_t i = 0; i != s; ++i)
+            y.pop_front();
+        std::vector<const int*> before;
+        for (std::size_t i = 0; i + B < y.size(); ++i)
+            before.push_back(&y[i]);
+        x.splice_front(std::move(y));
+        ASSERT_TRUE(y.empty());
+        ASSERT_EQ(x.size(), 4000u);
+        for (int i = 0; i < 4000; ++i)
+            ASSERT_EQ(x[i], i);
+        bool same = true;
+        for (std::size_t i = 0; i != before.size(); ++i)
+            same = same && (&x[i] == before[i]);
+        handed_over += same;}
+    ASSERT_EQ(handed_over, 1);
+}
+
+TEST(SpliceDequeTest, matches_std_deque) {
+    unsigned r = 7;
+    for (int round = 0; round < 300; ++round) {
+        MyDeque<std::string> x;
+        MyDeque<std::string> y;
+        std::deque<std::string> z;
+        std::deque<std::string> w;
+        r = r * 1103515245 + 12345;
+        const int n = (r >> 8) % 40;
+        const int m = (r >> 16) % 40;
+        for (int i = 0; i < n; ++i) {
+            x.push_front(std::to_string(i));
+            z.push_front(std::to_string(i));}
+        for (int i = 0; i < m; ++i) {
+            y.push_back(std::to_string(-i));
+            w.push_back(std::to_string(-i));}
+        if (r & 1) {
+            x.splice_back(std::move(y));
+            z.insert(z.end(), w.begin(), w.end());
+        } else {
+            x.splice_front(std::move(y));
+            z.insert(z.begin(), w.begin(), w.end());}
+        ASSERT_TRUE(y.empty());
+        ASSERT_EQ(x.size(), z.size());
+        ASSERT_TRUE(std::equal(z.begin(), z.end(), x.begin()));
+        x.push_front("f");
+        x.push_back("b");
+        ASSERT_EQ(x.front(), "f");
+        ASSERT_EQ(x.back(), "b");}
+}
+
+TEST(SpliceDequeTest, inline_storage) {
+    MyDeque<int, std::allocator<int>, 12> x;
+    MyDeque<int, std::allocator<int>, 12> y;
+    for (int i = 0; i < 20; ++i) {
+        x.push_back(i);
+        y.push_back(20 + i);}
+    x.splice_back(std::move(y));
+    ASSERT_TRUE(y.empty());
+    ASSERT_EQ(x.size(), 40u);
+    for (int i = 0; i < 40; ++i)
+        ASSERT_EQ(x[i], i);
+}
+
+// --------
+// split_at
+// --------
+
+TEST(SplitDequeTest, matches_std_deque) {
+    for (int n = 0; n < 30; ++n)
+        for (int i = 0; i <= n; ++i) {
+            MyDeque<std::string> x;
+            for (int j = 0; j < n; ++j)
+                x.push_front(std::to_string(n - 1 - j));
+            MyDeque<std::string> y = x.split_at(x.begin() + i);
+            ASSERT_EQ(x.size(), std::size_t(i));
+            ASSERT_EQ(y.size(), std::size_t(n - i));
+            for (int j = 0; j < i; ++j)
+                ASSERT_EQ(x[j], std::to_string(j));
+            for (int j = i; j < n; ++j)
+                ASSERT_EQ(y[j - i], std::to_string(j));
+            x.push_back("x");
+            x.push_front("x");
+            y.push_back("y");
+            y.push_front("y");
+            ASSERT_EQ(x.size(), std::size_t(i + 2));
+            ASSERT_EQ(y.size(), std::size_t(n - i + 2));}
+}
+
+TEST(SplitDequeTest, hands_over_rows) {
+    const std::size_t B = MyDeque<int>::INNER_SIZE;
+    MyDeque<int> x;
+    for (int i = 0; i < 10000; ++i)
+        x.push_back(i);
+    std::vector<const int*> before;
+    for (std::size_t i = 5000 + B; i != x.size(); ++i)
+        before.push_back(&x[i]);
+    MyDeque<int> y = x.split_at(x.begin() + 5000);
+    ASSERT_EQ(x.size(), 5000u);
+    ASSERT_EQ(y.size(), 5000u);
+    ASSERT_EQ(x.back(), 4999);
+    ASSERT_EQ(y.front(), 5000);
+    for (std::size_t i = 0; i != before.size(); ++i)
+        ASSERT_EQ(&y[B + i], before[i]);
+    x.splice_back(std::move(y));
+    ASSERT_EQ(x.size(), 10000u);
+    for (int i = 0; i < 10000; ++i)
+        ASSERT_EQ(x[i], i);
+}
+
+TEST(SplitDequeTest, inline_storage) {
+    MyDeque<int, std::allocator<int>, 12> x;
+    for (int i = 0; i < 30; ++i)
+        x.push_back(i);
+    MyDeque<int, std::allocator<int>, 12> y = x.split_at(x.begin() + 8);
+    ASSERT_EQ(x.size(), 8u);
+    ASSERT_EQ(y.size(), 22u);
+    ASSERT_EQ(x.back(), 7);
+    ASSERT_EQ(y.front(), 8);
+    ASSERT_EQ(y.back(), 29);
+}
+
+// ------------------
+// incremental growth
+// ------------------
+
+TEST(IncrementalGrowthDequeTest, matches_std_deque) {
+    typedef MyDeque<std::string, std::allocator<std::string>, 0, deque_incremental_growth> deque_type;
+    unsigned r = 5;
+    deque_type x;
+    std::deque<std::string> z;
+    for (int round = 0; round < 200000; ++round) {
+        r = r * 1103515245 + 12345;
+        const unsigned op = (r >> 16) % 100;
+        if (op < 40) {
+            x.push_back(std::to_string(round));
+            z.push_back(std::to_string(round));}
+        else if (op < 70) {
+            x.push_front(std::to_string(round));
+            z.push_front(std::to_string(round));}
+        else if (op < 83 && !z.empty()) {
+            ASSERT_EQ(x.front(), z.front());
+            x.pop_front();
+            z.pop_front();}
+        else if (op < 96 && !z.empty()) {
+            ASSERT_EQ(x.back(), z.back());
+            x.pop_back();
+            z.pop_back();}
+        else if (op < 99) {
+            const std::size_t k = std::min<std::size_t>((r >> 4) % 500, z.size());
+            x.erase_front(k);
+            z.erase(z.begin(), z.begin() + k);}
+        else if ((r >> 8) % 20 == 0) {
+            x.clear();
+            z.clear();}
+        ASSERT_EQ(x.size(), z.size());}
+    ASSERT_TRUE(std::equal(z.begin(), z.end(), x.begin()));
+    deque_type y(x);
+    ASSERT_TRUE(x == y);
+}
+
+TEST(IncrementalGrowthDequeTest, queue_drift_and_growth) {
+    typedef MyDeque<int, std::allocator<int>, 0, deque_incremental_growth> deque_type;
+    deque_type x;
+    for (int i = 0; i < 100000; ++i)
+        x.push_back(i);
+    for (int i = 0; i < 100000; ++i)
+        x.push_front(-1 - i);
+    ASSERT_EQ(x.size(), 200000u);
+    for (int i = 0; i < 200000; ++i)
+        ASSERT_EQ(x[i], i - 100000);
+    int next = 100000;
+    for (int i = 0; i < 1000000; ++i) {
+        x.push_back(next++);
+        x.pop_front();}
+    ASSERT_EQ(x.front(), next - 200000);
+    ASSERT_EQ(x.back(), next - 1);
+    std::vector<int> in(50000, 7);
+    x.push_back_n(in.data(), in.size());
+    x.push_front_n(in.data(), in.size());
+    ASSERT_EQ(x.size(), 300000u);
+    ASSERT_EQ(x[49999], 7);
+    ASSERT_EQ(x[50000], next - 200000);
+    deque_type y = x.split_at(x.begin() + 150000);
+    x.splice_back(std::move(y));
+    ASSERT_EQ(x.size(), 300000u);
+    ASSERT_EQ(x.back(), 7);
+}
+
+// -----
+// slice
+// -----
+
+TEST(SliceDequeTest, views_without_copying) {
+    MyDeque<std::string> x;
+    for (int i = 0; i < 100; ++i)
+        x.push_front(std::to_string(99 - i));
+    for (std::size_t first = 0; first <= 100; first += 7)
+        for (std::size_t last = first; last <= 100; last += 11) {
+            const MyDeque<std::string>::const_slice v = x.slice(first, last);
+            ASSERT_EQ(v.size(), last - first);
+            ASSERT_EQ(v.end() - v.begin(), std::ptrdiff_t(last - first));
+            ASSERT_TRUE(std::equal(v.begin(), v.end(), x.begin() + first));
+            ASSERT_TRUE(std::equal(v.rbegin(), v.rend(), x.rbegin() + (100 - last)));
+            for (std::size_t i = 0; i != v.size(); ++i)
+                ASSERT_EQ(&v[i], &x[first + i]);
+            if (!v.empty()) {
+                ASSERT_EQ(v.front(), std::to_string(first));
+                ASSERT_EQ(v.back(), std::to_string(last - 1));}}
+    const MyDeque<std::string>::const_slice w = x.slice(10, 90).slice(5, 15);
+    ASSERT_EQ(w.size(), 10u);
+    ASSERT_EQ(w.front(), "15");
+    ASSERT_EQ(&w.back(), &x[24]);
+}
+
+TEST(SliceDequeTest, segments) {
+    const std::size_t B = MyDeque<long>::INNER_SIZE;
+    MyDeque<long> x;
+    for (long i = 0; i < 1000; ++i)
+        x.push_back(i);
+    const MyDeque<long>::const_slice v = x.slice(3, 3 + 4 * B);
+    long sum = 0;
+    std::size_t runs = 0;
+    v.for_each_segment([&] (const long* p, std::size_t n) {
+        ++runs;
+        sum = std::accumulate(p, p + n, sum);});
+    ASSERT_EQ(sum, std::accumulate(v.begin(), v.end(), 0L));
+    ASSERT_LE(runs, 5u);
+    const MyDeque<long>::const_slice all = x;
+    ASSERT_EQ(all.size(), 1000u);
+    ASSERT_EQ(all.back(), 999);
+    const MyDeque<long> y;
+    const MyDeque<long>::const_slice none = y;
+    ASSERT_TRUE(none.empty());
+    ASSERT_TRUE(none.begin() == none.end());
+    ASSERT_TRUE(y.slice(0, 0).begin() == y.slice(0, 0).end());
+}
+
+// -----
+// batch
+// -----
+
+TEST(BatchDequeTest, matches_std_deque) {
+    unsigned r = 11;
+    MyDeque<std::string> x;
+    std::deque<std::string> z;
+    std::vector<std::string> in;
+    for (int i = 0; i < 64; ++i)
+        in.push_back(std::to_string(i));
+    for (int round = 0; round < 2000; ++round) {
+        r = r * 1103515245 + 12345;
+        const std::size_t n = (r >> 8) % 48;
+        const std::size_t k = std::min(n, x.size());
+        std::vector<std::string> out;
+        switch ((r >> 16) % 6) {
+            case 0:
+                x.push_back_n(in.data(), n);
+                z.insert(z.end(), in.begin(), in.begin() + n);
+                break;
+            case 1:
+                x.push_front_n(in.data(), n);
+                z.insert(z.begin(), in.begin(), in.begin() + n);
+                break;
+            case 2:
+                x.pop_front_n(std::back_inserter(out), k);
+                ASSERT_TRUE(std::equal(out.begin(), out.end(), z.begin()));
+                z.erase(z.begin(), z.begin() + k);
+                break;
+            case 3:
+                x.pop_back_n(std::back_inserter(out), k);
+                ASSERT_TRUE(std::equal(out.begin(), out.end(), z.end() - k));
+                z.erase(z.end() - k, z.end());
+                break;
+            case 4:
+                x.erase_front(k);
+                z.erase(z.begin(), z.begin() + k);
+                break;
+            default:
+                x.resize(n * 2, "r");
+                z.resize(n * 2, "r");}
+        ASSERT_EQ(x.size(), z.size());
+        ASSERT_TRUE(std::equal(z.begin(), z.end(), x.begin()));}
+    x.erase_back(x.size());
+    ASSERT_TRUE(x.empty());
+    x.push_front("f");
+    x.push_back("b");
+    ASSERT_EQ(x.front(), "f");
+    ASSERT_EQ(x.back(), "b");
+}
+
+TEST(BatchDequeTest, large_and_empty) {
+    std::vector<long> in(100000);
+    for (std::size_t i = 0; i != in.size(); ++i)
+        in[i] = i;
+    MyDeque<long> x;
+    x.push_front_n(in.data(), in.size());
+    x.push_back_n(in.data(), in.size());
+    ASSERT_EQ(x.size(), 200000u);
+    ASSERT_EQ(x[99999], 99999);
+    ASSERT_EQ(x[100000], 0);
+    std::vector<long> out(150000);
+    ASSERT_EQ(x.pop_front_n(out.begin(), 150000), out.end());
+    ASSERT_EQ(out[149999], 49999);
+    ASSERT_EQ(x.front(), 50000);
+    x.resize(10);
+    ASSERT_EQ(x.back(), 50009);
+    x.resize(0);
+    ASSERT_TRUE(x.empty());
+    x.push_back_n(in.data(), 0);
+    x.push_front_n(in.data(), 0);
+    ASSERT_TRUE(x.empty());
+}
+
+TEST(BatchDequeTest, inline_storage) {
+    MyDeque<int, std::allocator<int>, 12> x;
+    const int in[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+    x.push_back_n(in, 10);
+    x.push_front_n(in, 10);
+    x.push_back_n(in, 10);
+    ASSERT_EQ(x.size(), 30u);
+    for (int i = 0; i < 30; ++i)
+        ASSERT_EQ(x[i], i % 10);
+    int out[15];
+    x.pop_back_n(out, 15);
+    ASSERT_EQ(out[0], 5);
+    ASSERT_EQ(out[14], 9);
+    x.erase_front(5);
+    ASSERT_EQ(x.size(), 10u);
+    ASSERT_EQ(x.front(), 5);
+    ASSERT_EQ(x.back(), 4);
+}
+
+// -------------
+// SlidingWindow
+// -------------
+
+TEST(SlidingWindowTest, sum_by_count) {
+    SlidingWindow<long> w;
+    std::deque<long> z;
+    unsigned r = 3;
+    for (int i = 0; i < 5000; ++i) {
+        r = r * 1103515245 + 12345;
+        const long v = (r >> 8) % 1000;
+        w.push_back(v);
+        z.push_back(v);
+        const std::size_t n = 1 + (r >> 20) % 64;
+        ASSERT_EQ(w.expire_count(n), z.size() > n ? z.size() - n : 0);
+        while (z.size() > n)
+            z.pop_front();
+        ASSERT_EQ(w.size(), z.size());
+        ASSERT_EQ(w.aggregate(), std::accumulate(z.begin(), z.end(), 0L));}
+}
+
+TEST(SlidingWindowTest, non_commutative_op) {
+    struct concat {
+        std::string operator () (const std::string& a, const std::string& b) const {
+            return a + b;}};
+    SlidingWindow<std::string, concat> w;
+    for (char c = 'a'; c <= 'z'; ++c) {
+        w.push_back(std::string(1, c));
+        w.expire_count(4);}
+    ASSERT_EQ(w.aggregate(), "wxyz");
+    w.pop_front();
+    w.push_back("!");
+    ASSERT_EQ(w.aggregate(), "xyz!");
+}
+
+TEST(SlidingWindowTest, expire_by_time) {
+    SlidingWindow<int> w;
+    MonotonicWindow<int> lo;
+    MonotonicWindow<int, std::greater<int> > hi;
+    for (int t = 0; t < 100; ++t) {
+        const int v = (t * 37) % 101;
+        w.push_back(v, t);
+        lo.push_back(v, t);
+        hi.push_back(v, t);
+        w.expire_before(t - 9);
+        lo.expire_before(t - 9);
+        hi.expire_before(t - 9);
+        int sum = 0, mn = 1000, mx = -1;
+        for (int u = std::max(0, t - 9); u <= t; ++u) {
+            sum += (u * 37) % 101;
+            mn = std::min(mn, (u * 37) % 101);
+            mx = std::max(mx, (u * 37) % 101);}
+        ASSERT_EQ(w.size(), std::size_t(std::min(t + 1, 10)));
+        ASSERT_EQ(lo.size(), w.size());
+        ASSERT_EQ(w.aggregate(), sum);
+        ASSERT_EQ(lo.extreme(), mn);
+        ASSERT_EQ(hi.extreme(), mx);}
+}
+
+TEST(SlidingWindowTest, monotonic_ties) {
+    MonotonicWindow<int> w;
+    w.push_back(2);
+    w.push_back(1);
+    w.push_back(1);
+    w.push_back(3);
+    ASSERT_EQ(w.extreme(), 1);
+    w.pop_front();
+    w.pop_front();
+    ASSERT_EQ(w.extreme(), 1);
+    w.pop_front();
+    ASSERT_EQ(w.extreme(), 3);
+    w.pop_front();
+    ASSERT_TRUE(w.empty());
+}
+
+// -----------
+// SortedDeque
+// -----------
+
+TEST(SortedDequeTest, matches_multiset) {
+    SortedDeque<int, std::less<int>, 8> x;
+    std::multiset<int> z;
+    unsigned r = 11;
+    for (int i = 0; i < 20000; ++i) {
+        r = r * 1103515245 + 12345;
+        const int v = (r >> 8) % 500;
+        const unsigned op = (r >> 20) % 8;
+        if (op < 5 || z.empty()) {
+            ASSERT_EQ(*x.insert_sorted(v), v);
+            z.insert(v);}
+        else if (op == 5) {
+            x.pop_front();
+            z.erase(z.begin());}
+        else if (op == 6) {
+            x.pop_back();
+            z.erase(--z.end());}
+        else {
+            SortedDeque<int, std::less<int>, 8>::const_iterator p = x.find(v);
+            ASSERT_EQ(p == x.end(), !z.count(v));
+            if (p != x.end()) {
+                x.erase(p);
+                z.erase(z.find(v));}}
+        ASSERT_EQ(x.size(), z.size());
+        ASSERT_EQ(std::distance(x.begin(), x.lower_bound(v)), std::distance(z.begin(), z.lower_bound(v)));
+        ASSERT_EQ(std::distance(x.begin(), x.upper_bound(v)), std::distance(z.begin(), z.upper_bound(v)));}
+    ASSERT_TRUE(std::equal(z.begin(), z.end(), x.begin()));
+    ASSERT_EQ(x.front(), *z.begin());
+    ASSERT_EQ(x.back(), *z.rbegin());
+}
+
+TEST(SortedDequeTest, equal_keys_keep_order) {
+    typedef std::pair<int, int> event;
+    struct by_time {
+        bool operator () (const event& a, const event& b) const {
+            return a.first < b.first;}};
+    SortedDeque<event, by_time, 4> x;
+    for (int i = 0; i < 40; ++i)
+        x.insert_sorted(event(i % 3, i));
+    int last = -1;
+    for (SortedDeque<event, by_time, 4>::const_iterator b = x.lower_bound(event(1, 0)); b != x.upper_bound(event(1, 0)); ++b) {
+        ASSERT_EQ(b->first, 1);
+        ASSERT_LT(last, b->second);
+        last = b->second;}
+    ASSERT_EQ(last, 37);
+}
+
+TEST(SortedDequeTest, erase_and_copy) {
+    SortedDeque<std::string, std::less<std::string>, 4> x;
+    for (int i = 0; i < 50; ++i)
+        x.insert_sorted(std::to_string(1000 + (i * 7) % 50));
+    SortedDeque<std::string, std::less<std::string>, 4> y(x);
+    SortedDeque<std::string, std::less<std::string>, 4>::const_iterator p = x.begin();
+    while (p != x.end())
+        p = x.erase(p);
+    ASSERT_TRUE(x.empty());
+    ASSERT_EQ(y.size(), 50u);
+    ASSERT_EQ(y.front(), "1000");
+    ASSERT_EQ(y.back(), "1049");
+    x = y;
+    ASSERT_TRUE(std::equal(y.begin(), y.end(), x.begin()));
+}
+
+// --------
+// prefetch
+// --------
+
+TEST(PrefetchDequeTest, any_distance) {
+    MyDeque<int> x;
+    for (int i = 0; i < 1000; ++i)
+        x.push_front(i);
+    const std::size_t distances[] = {0, 1, 3, MyDeque<int>::PREFETCH_ROWS, 10000};
+    for (std::size_t d : distances) {
+        long sum = 0;
+        std::size_t n = 0;
+        x.for_each_segment([&] (const int* p, std::size_t k) {
+            for (std::size_t i = 0; i != k; ++i)
+                sum += p[i];
+            n += k;}, d);
+        ASSERT_EQ(n, 1000u);
+        ASSERT_EQ(sum, 999L * 1000 / 2);}
+    MyDeque<int> y;
+    y.for_each_segment([] (const int*, std::size_t) {
+        FAIL();}, 4);
+}
+
+// --------------
+// BlockAllocator
+// --------------
+
+TEST(BlockAllocatorTest, aligned_rows) {
+    typedef MyDeque<long, AlignedAllocator<long> > deque_type;
+    ASSERT_EQ(deque_type::INNER_SIZE, 32u);
+    deque_type x;
+    for (long i = 0; i < 1000; ++i)
+        x.push_front(i);
+    std::size_t rows = 0;
+    x.for_each_segment([&] (const long* p, std::size_t k) {
+        if (k == deque_type::INNER_SIZE) {
+            ++rows;
+            ASSERT_EQ(reinterpret_cast<std::uintptr_t>(p) % 64, 0u);}});
+    ASSERT_GE(rows, 1000u / 32 - 1);
+}
+
+TEST(BlockAllocatorTest, huge_page_arena) {
+    huge_page_arena a;
+    {
+    MyDeque<long, HugePageAllocator<long> > x((HugePageAllocator<long>(&a)));
+    std::deque<long> z;
+    for (long i = 0; i < 200000; ++i) {
+        if (i % 3) {
+            x.push_back(i);
+            z.push_back(i);}
+        else {
+            x.push_front(i);
+            z.push_front(i);}
+        if (i % 7 == 0) {
+            x.pop_back();
+            z.pop_back();}}
+    ASSERT_TRUE(std::equal(z.begin(), z.end(), x.begin()));
+    ASSERT_EQ(reinterpret_cast<std::uintptr_t>(&x.front()) % 64, (x.get_layout().start % MyDeque<long, HugePageAllocator<long> >::INNER_SIZE) * sizeof(long) % 64);
+    ASSERT_GE(a.mapped(), 200000 * sizeof(long) * 6 / 7);
+    }
+    ASSERT_EQ(a.mapped() % huge_page_arena::REGION, 0u);
+    void* p = a.allocate(1);
+    void* q = a.allocate(64);
+    ASSERT_EQ(reinterpret_cast<std::uintptr_t>(p) % 64, 0u);
+    ASSERT_NE(p, q);
+    a.deallocate(p, 1);
+    ASSERT_EQ(a.allocate(40), p);
+    a.deallocate(p, 40);
+    a.deallocate(q, 64);
+}
+
+// ------------
+// ShardedDeque
+// ------------
+
+TEST(ShardedDequeTest, shard_fifo_and_steal) {
+    ShardedDeque<int> x(3);
+    ASSERT_EQ(x.shards(), 3u);
+    for (int i = 0; i < 100; ++i)
+        x.push_back(i, 0);
+    int v = -1;
+    ASSERT_TRUE(x.try_pop(v, 0));
+    ASSERT_EQ(v, 0);
+    ASSERT_TRUE(x.try_pop(v, 1));
+    ASSERT_EQ(v, 1);
+    ASSERT_EQ(x.shard_size(0), 49u);
+    ASSERT_EQ(x.shard_size(1), 49u);
+    for (int i = 2; i < 51; ++i) {
+        ASSERT_TRUE(x.try_pop(v, 1));
+        ASSERT_EQ(v, i);}
+    ASSERT_TRUE(x.try_pop(v, 2));
+    ASSERT_EQ(v, 51);
+    ASSERT_EQ(x.size(), 48u);
+    std::multiset<int> rest;
+    while (x.try_pop(v, 2))
+        rest.insert(v);
+    ASSERT_EQ(rest.size(), 48u);
+    ASSERT_EQ(*rest.begin(), 52);
+    ASSERT_TRUE(x.empty());
+    ASSERT_FALSE(x.try_pop(v));
+}
+
+struct steal_item {
+    static int moves_left;
+    int v;
+    steal_item (int v = 0) : v(v) {}
+    steal_item (const steal_item&) = default;
+    steal_item (steal_item&& that) : v(that.v) {
+        if (!moves_left--)
+            throw std::runtime_error("steal_item");}
+    steal_item& operator = (const steal_item&) = default;
+    steal_item& operator = (steal_item&&) = default;};
+
+int steal_item::moves_left = -1;
+
+TEST(ShardedDequeTest, steal_keeps_rest_on_throw) {
+    ShardedDeque<steal_item> x(2);
+    for (int i = 0; i < 10; ++i)
+        x.push_back(steal_item(i), 0);
+    // five move into the batch, two onto shard 1, and the next throws
+    steal_item::moves_left = 5 + 2;
+    steal_item v;
+    ASSERT_TRUE(x.try_pop(v, 1));
+    steal_item::moves_left = -1;
+    ASSERT_EQ(v.v, 0);
+    ASSERT_EQ(x.shard_size(1), 2u);
+    ASSERT_EQ(x.shard_size(0), 7u);
+    for (int i = 1; i < 3; ++i) {
+        ASSERT_TRUE(x.try_pop(v, 1));
+        ASSERT_EQ(v.v, i);}
+    for (int i = 3; i < 10; ++i) {
+        ASSERT_TRUE(x.try_pop(v, 0));
+        ASSERT_EQ(v.v, i);}
+    ASSERT_TRUE(x.empty());
+}
+
+TEST(ShardedDequeTest, local_shard) {
+    ShardedDeque<std::string> x;
+    ASSERT_GE(x.shards(), 1u);
+    ASSERT_LT(x.local_shard(), x.shards());
+    ShardedDeque<std::string> y(ShardedDeque<std::string>::per_node);
+    ASSERT_GE(y.shards(), 1u);
+    const std::string in[] = {"a", "b", "c"};
+    y.push_back_n(in, 3);
+    y.push_back("d");
+    std::string v;
+    for (int i = 0; i < 4; ++i)
+        ASSERT_TRUE(y.try_pop(v));
+    ASSERT_EQ(v, "d");
+}
+
+TEST(ShardedDequeTest, threads) {
+    ShardedDeque<long> x(4);
+    const int threads = 4;
+    const long n = 20000;
+    std::atomic<long> popped(0);
+    std::vector<long> sums(threads, 0);
+    std::vector<std::thread> t;
+    for (int i = 0; i < threads; ++i)
+        t.push_back(std::thread([&x, &popped, &sums, i, n, threads] () {
+            for (long j = 0; j < n; ++j) {
+                x.push_back(j * threads + i, i);
+                long v;
+                if (j % 2 && x.try_pop(v, i)) {
+                    sums[i] += v;
+                    ++popped;}}}));
+    for (int i = 0; i < threads; ++i)
+        t[i].join();
+    long sum = std::accumulate(sums.begin(), sums.end(), 0L);
+    long v;
+    while (x.try_pop(v)) {
+        sum += v;
+        ++popped;}
+    ASSERT_EQ(popped.load(), threads * n);
+    ASSERT_EQ(sum, threads * n * (threads * n - 1) / 2);
+}
+
+// ---------------
+// CompressedDeque
+// ---------------
+
+TEST(CompressedDequeTest, matches_std_deque) {
+    std::mt19937_64 g(11);
+    CompressedDeque<std::int64_t, 16> x;
+    std::deque<std::int64_t> y;
+    std::int64_t v = 0;
+    for (int i = 0; i != 20000; ++i) {
+        const unsigned op = g() % 8;
+        if (op < 3) {
+            v += static_cast<std::int64_t>(g() % 1000) - 100;
+            x.push_back(v);
+            y.push_back(v);}
+        else if (op < 5) {
+            x.push_front(-v);
+            y.push_front(-v);}
+        else if (op == 5) {
+            const std::int64_t w = static_cast<std::int64_t>(g());
+            x.push_back(w);
+            y.push_back(w);}
+        else if (!y.empty()) {
+            if (op == 6) {
+                x.pop_back();
+                y.pop_back();}
+            else {
+                x.pop_front();
+                y.pop_front();}}
+        ASSERT_EQ(x.size(), y.size());
+        if (!y.empty()) {
+            ASSERT_EQ(x.front(), y.front());
+            ASSERT_EQ(x.back(), y.back());
+            const std::size_t k = g() % y.size();
+            ASSERT_EQ(x[k], y[k]);}}
+    std::vector<std::int64_t> z;
+    x.for_each_segment([&] (const std::int64_t* p, std::size_t n) {
+        z.insert(z.end(), p, p + n);});
+    ASSERT_TRUE(std::equal(z.begin(), z.end(), y.begin()));
+    ASSERT_EQ(z.size(), y.size());
+    CompressedDeque<std::int64_t, 16> w(x);
+    x.clear();
+    ASSERT_TRUE(x.empty());
+    ASSERT_EQ(w.size(), y.size());
+    ASSERT_EQ(w.at(y.size() - 1), y.back());
+    ASSERT_THROW(w.at(y.size()), std::out_of_range);
+}
+
+TEST(CompressedDequeTest, timestamps_compress) {
+    CompressedDeque<> x;
+    std::uint64_t t = 1700000000000000000ull;
+    for (std::uint64_t i = 0; i != 100000; ++i) {
+        t += 1000 + (i * 7919) % 200;
+        x.push_back(t);}
+    ASSERT_EQ(x.back(), t);
+    ASSERT_LT(x.bytes() * 5, x.size() * sizeof(std::uint64_t));
+    CompressedDeque<> y;
+    for (std::uint64_t i = 0; i != 10000; ++i)
+        y.push_front(5 * i);
+    ASSERT_LT(y.bytes() * 8, y.size() * sizeof(std::uint64_t));
+    for (std::uint64_t i = 0; i != 10000; ++i) {
+        ASSERT_EQ(y.back(), 5 * i);
+        y.pop_back();}
+    ASSERT_TRUE(y.empty());
+}
+
+TEST(CompressedDequeTest, full_width) {
+    CompressedDeque<std::uint32_t, 4> x;
+    const std::uint32_t a[] = {0, 0xffffffffu, 1, 0x80000000u, 7, 7, 7, 7, 0xfffffffeu, 3};
+    for (int r = 0; r != 10; ++r)
+        for (int i = 0; i != 10; ++i)
+            x.push_back(a[i]);
+    for (int i = 0; i != 100; ++i)
+        ASSERT_EQ(x[i], a[i % 10]);
+    CompressedDeque<std::uint64_t, 3> y;
+    const std::uint64_t b[] = {0, ~std::uint64_t(0), 0, 1ull << 63, 1};
+    for (int r = 0; r != 6; ++r)
+        for (int i = 0; i != 5; ++i)
+            y.push_back(b[i]);
+    for (int i = 0; i != 30; ++i) {
+        ASSERT_EQ(y.front(), b[i % 5]);
+        y.pop_front();}
+}
+
+// -----------
+// TieredDeque
+// -----------
+
+TEST(TieredDequeTest, matches_std_deque) {
+    std::mt19937 g(5);
+    TieredDeque<std::string> x;
+    std::deque<std::string> y;
+    for (int i = 0; i != 30000; ++i) {
+        const unsigned op = g() % 10;
+        const std::string v = std::to_string(i);
+        if (op < 4 || y.empty()) {
+            const std::size_t k = g() % (y.size() + 1);
+            ASSERT_EQ(*x.insert(x.begin() + k, v), v);
+            y.insert(y.begin() + k, v);}
+        else if (op < 6) {
+            const std::size_t k = g() % y.size();
+            TieredDeque<std::string>::iterator p = x.erase(x.begin() + k);
+            y.erase(y.begin() + k);
+            if (k != y.size()) {
+                ASSERT_EQ(*p, y[k]);}}
+        else if (op == 6) {
+            x.push_back(v);
+            y.push_back(v);}
+        else if (op == 7) {
+            x.push_front(v);
+            y.push_front(v);}
+        else if (op == 8) {
+            x.pop_back();
+            y.pop_back();}
+        else {
+            x.pop_front();
+            y.pop_front();}
+        ASSERT_EQ(x.size(), y.size());
+        if (!y.empty()) {
+            ASSERT_EQ(x.front(), y.front());
+            ASSERT_EQ(x.back(), y.back());
+            const std::size_t k = g() % y.size();
+            ASSERT_EQ(x[k], y[k]);}}
+    ASSERT_TRUE(std::equal(x.begin(), x.end(), y.begin()));
+    ASSERT_THROW(x.at(y.size()), std::out_of_range);
+}
+
+TEST(TieredDequeTest, rows_follow_sqrt) {
+    TieredDeque<int> x;
+    for (int i = 0; i != 100000; ++i)
+        x.insert(x.begin() + x.size() / 2, i);
+    ASSERT_GE(x.row_size() * 2, x.rows());
+    ASSERT_LE(x.row_size() / 8, x.rows());
+    ASSERT_GT(x.row_size(), 64u);
+    TieredDeque<int> y(x);
+    while (x.size() > 100)
+        x.erase(x.begin() + x.size() / 3);
+    ASSERT_LE(x.row_size(), 32u);
+    ASSERT_EQ(y.size(), 100000u);
+    ASSERT_EQ(y[0], 1);
+    ASSERT_EQ(y[99999], 0);
+    std::sort(y.begin(), y.end());
+    for (int i = 0; i != 100000; ++i)
+        ASSERT_EQ(y[i], i);
+    const TieredDeque<int>& z = y;
+    TieredDeque<int>::const_iterator b = y.begin();
+    ASSERT_EQ(z.end() - b, 100000);
+    ASSERT_EQ(b[7], 7);
+}
+
+// -----------
+// SharedDeque
+// -----------
+
+struct shared_record {
+    std::uint64_t ts;
+    double        price;
+    std::uint32_t qty;
+    std::uint32_t flags;};
+
+TEST(SharedDequeTest, fork) {
+    const std::string name = "/TestDeque-" + std::to_string(::getpid());
+    const int n = 100000;
+    SharedDeque<shared_record> x(name, 1000);
+    ASSERT_EQ(x.capacity() % (SharedDeque<shared_record>::ROW_BYTES / sizeof(shared_record)), 0u);
+    const pid_t pid = ::fork();
+    ASSERT_GE(pid, 0);
+    if (!pid) {
+        // the producer maps the segment again, at another address
+        int status = 0;
+        try {
+            SharedDeque<shared_record> y(name);
+            shared_record batch[37];
+            for (int i = 0; i < n; ) {
+                if (i % 3) {
+                    const shared_record r = {std::uint64_t(i), i * 0.5, std::uint32_t(i), 1};
+                    y.push_back(r);
+                    ++i;}
+                else {
+                    const int k = std::min(37, n - i);
+                    for (int j = 0; j != k; ++j) {
+                        const shared_record r = {std::uint64_t(i + j), (i + j) * 0.5, std::uint32_t(i + j), 2};
+                        batch[j] = r;}
+                    y.push_back_n(batch, k);
+                    i += k;}}
+            y.close();}
+        catch (...) {
+            status = 1;}
+        ::_exit(status);}
+    std::uint64_t next = 0;
+    bool ordered = true;
+    shared_record r, batch[100];
+    while (next != std::uint64_t(n) && ordered) {
+        if (next % 5 == 0) {
+            ASSERT_TRUE(x.pop_front(r));
+            ordered = (r.ts == next) && (r.qty == next) && (r.price == next * 0.5);
+            ++next;}
+        else if (next % 5 == 1) {
+            const std::size_t k = x.pop_front_n(batch, 100);
+            ASSERT_GT(k, 0u);
+            for (std::size_t j = 0; j != k; ++j, ++next)
+                ordered = ordered && (batch[j].ts == next);}
+        else
+            ASSERT_GT(x.consume([&] (const shared_record* p, std::size_t k) {
+                for (std::size_t j = 0; j != k; ++j, ++next)
+                    ordered = ordered && (p[j].ts == next);}), 0u);}
+    ASSERT_TRUE(ordered);
+    ASSERT_FALSE(x.pop_front(r));
+    int status = -1;
+    ASSERT_EQ(::waitpid(pid, &status, 0), pid);
+    ASSERT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    ASSERT_TRUE(SharedDeque<shared_record>::unlink(name));
+}
+
+TEST(SharedDequeTest, open_and_full) {
+    const std::string name = "/TestDeque-full-" + std::to_string(::getpid());
+    ASSERT_THROW(SharedDeque<int> y(name), std::system_error);
+    SharedDeque<int> x(name, 10);
+    ASSERT_THROW(SharedDeque<int> y(name, 10), std::system_error);
+    ASSERT_THROW(SharedDeque<double> y(name), std::runtime_error);
+    SharedDeque<int> y(name);
+    ASSERT_TRUE(SharedDeque<int>::unlink(name));
+    {
+    // zero filled, as if no SharedDeque made it or its creator died before finishing
+    const std::string foreign = name + "-foreign";
+    const int fd = ::shm_open(foreign.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(::ftruncate(fd, 1 << 20), 0);
+    ::close(fd);
+    ASSERT_THROW(SharedDeque<int> z(foreign), std::runtime_error);
+    ASSERT_TRUE(SharedDeque<int>::unlink(foreign));
+    }
+    int i = 0;
+    while (x.try_push_back(i))
+        ++i;
+    ASSERT_EQ(std::size_t(i), x.capacity());
+    ASSERT_EQ(y.size(), x.capacity());
+    std::thread t([&] () {
+        for (int j = 0; j != 3 * i; ++j)
+            x.push_back(i + j);
+        x.close();});
+    int v, expected = 0;
+    while (y.pop_front(v))
+        ASSERT_EQ(v, expected++);
+    t.join();
+    ASSERT_EQ(expected, 4 * i);
+    ASSERT_TRUE(y.empty());
+}
+
+TEST(SharedDequeTest, open_waits_for_size) {
+    const std::string name = "/TestDeque-race-" + std::to_string(::getpid());
+    // what an opener sees between the creator's shm_open() and ftruncate()
+    const int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    ASSERT_GE(fd, 0);
+    std::thread t([fd] () {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        ASSERT_EQ(::ftruncate(fd, 8192), 0);});
+    deque_shm_segment x(name);
+    t.join();
+    ::close(fd);
+    ASSERT_EQ(x.size(), 8192u);
+    ASSERT_TRUE(deque_shm_segment::unlink(name));
+    SharedDeque<int> y(name, 10);
+    int out[4];
+    ASSERT_EQ(y.pop_front_n(out, 0), 0u);
+    y.push_back(7);
+    ASSERT_EQ(y.pop_front_n(out, 0), 0u);
+    ASSERT_EQ(y.pop_front_n(out, 4), 1u);
+    ASSERT_EQ(out[0], 7);
+    ASSERT_TRUE(SharedDeque<int>::unlink(name));
+}
+
+// --------
+// SoADeque
+// --------
+
+TEST(SoADequeTest, matches_std_deque) {
+    typedef std::tuple<std::uint64_t, double, std::string, std::uint8_t> record;
+    SoADeque<std::uint64_t, double, std::string, std::uint8_t> x;
+    std::deque<record> y;
+    std::mt19937 g(46);
+    for (int i = 0; i != 5000; ++i) {
+        const int op = g() % 5;
+        const record r(i, i * 0.25, std::to_string(i), std::uint8_t(i));
+        if (op == 0)
+            x.push_front(r), y.push_front(r);
+        else if (op == 1)
+            x.push_back(std::get<0>(r), std::get<1>(r), std::get<2>(r), std::get<3>(r)), y.push_back(r);
+        else if (op == 2 && !y.empty())
+            x.pop_front(), y.pop_front();
+        else if (op == 3 && !y.empty())
+            x.pop_back(), y.pop_back();
+        else
+            x.push_back(r), y.push_back(r);}
+    ASSERT_EQ(x.size(), y.size());
+    ASSERT_EQ(record(x.front()), y.front());
+    ASSERT_EQ(record(x.back()), y.back());
+    for (std::size_t i = 0; i != y.size(); ++i)
+        ASSERT_EQ(record(x[i]), y[i]);
+    std::get<2>(x[1]) = "one";
+    x.get<0>(1) = 7;
+    ASSERT_EQ(x.get<2>(1), "one");
+    ASSERT_EQ(std::get<0>(x.at(1)), 7u);
+    ASSERT_THROW(x.at(x.size()), std::out_of_range);
+    x.clear();
+    ASSERT_TRUE(x.empty());
+}
+
+TEST(SoADequeTest, column_segments) {
+    typedef SoADeque<std::uint64_t, double, std::uint32_t, std::uint8_t> soa;
+    soa x;
+    for (int i = 0; i != 3000; ++i)
+        x.push_front(i, i * 0.5, std::uint32_t(i), std::uint8_t(i));
+    for (int i = 0; i != 3000; ++i)
+        x.push_back(i, i * 0.5, std::uint32_t(i), std::uint8_t(i));
+    ASSERT_EQ(x.column<1>().size(), x.size());
+    std::vector<std::size_t> lengths;
+    double sum = 0;
+    x.for_each_segment<1>([&] (const double* p, std::size_t n) {
+        ASSERT_LE(n, soa::ROW);
+        lengths.push_back(n);
+        for (std::size_t i = 0; i != n; ++i)
+            sum += p[i];});
+    ASSERT_EQ(sum, 2 * 0.5 * (2999 * 3000 / 2));
+    std::vector<std::size_t> other;
+    std::size_t full = 0;
+    x.for_each_segment<3>([&] (const std::uint8_t* p, std::size_t n) {
+        other.push_back(n);
+        if (n == soa::ROW) {
+            ++full;
+            ASSERT_EQ(reinterpret_cast<std::uintptr_t>(p) % 64, 0u);}});
+    ASSERT_EQ(lengths, other);
+    ASSERT_GT(full, 0u);
+}
+
+struct soa_thrower {
+    static bool fail;
+    int v;
+    soa_thrower (int v) : v(v) {}
+    soa_thrower (const soa_thrower& that) : v(that.v) {
+        if (fail)
+            throw std::runtime_error("soa_thrower");}
+    soa_thrower& operator = (const soa_thrower&) = default;};
+
+bool soa_thrower::fail = false;
+
+TEST(SoADequeTest, push_rolls_back) {
+    SoADeque<int, soa_thrower> x;
+    x.push_back(1, soa_thrower(1));
+    soa_thrower::fail = true;
+    ASSERT_THROW(x.push_back(2, soa_thrower(2)), std::runtime_error);
+    ASSERT_THROW(x.push_front(0, soa_thrower(0)), std::runtime_error);
+    soa_thrower::fail = false;
+    ASSERT_EQ(x.size(), 1u);
+    ASSERT_EQ(x.column<0>().size(), 1u);
+    ASSERT_EQ(std::get<0>(x.front()), 1);
+    ASSERT_EQ(x.get<1>(0).v, 1);
+}
+
+// ---------
+// DequeSort
+// ---------
+
+TEST(DequeSortTest, sort) {
+    MyDeque<std::string> x;
+    deque_sort(x);
+    ASSERT_TRUE(x.empty());
+    const char* const a[] = {"pear", "fig", "apple", "kiwi", "fig", "banana"};
+    std::vector<std::string> y(a, a + 6);
+    x.push_back_n(y.data(), y.size());
+    deque_sort(x, std::greater<std::string>());
+    std::sort(y.begin(), y.end(), std::greater<std::string>());
+    ASSERT_TRUE(std::equal(x.begin(), x.end(), y.begin()));
+    std::mt19937 g(42);
+    MyDeque<int> z;
+    for (int i = 0; i != 100000; ++i)
+        z.push_front(static_cast<int>(g() % 1000));
+    deque_sort(z);
+    ASSERT_TRUE(std::is_sorted(z.begin(), z.end()));
+    ASSERT_EQ(z.size(), 100000u);
+}
+
+TEST(DequeSortTest, stable_sort) {
+    typedef std::pair<int, int> value_type;
+    struct by_first {
+        bool operator () (const value_type& a, const value_type& b) const {
+            return a.first < b.first;}};
+    std::mt19937 g(7);
+    // 1 run, 3 runs (one left over after the first round) and 4 runs
+    const std::size_t sizes[] = {0, 1, 1000, 2 * 65536 + 7, 3 * 65536 + 1};
+    for (std::size_t s = 0; s != 5; ++s) {
+        MyDeque<value_type> x;
+        std::vector<value_type> y;
+        for (std::size_t i = 0; i != sizes[s]; ++i) {
+            y.push_back(value_type(static_cast<int>(g() % 100), static_cast<int>(i)));
+            x.push_back(y.back());}
+        deque_stable_sort(x, by_first());
+        std::stable_sort(y.begin(), y.end(), by_first());
+        ASSERT_EQ(x.size(), y.size());
+        ASSERT_TRUE(std::equal(x.begin(), x.end(), y.begin()));}
+    MyDeque<std::string> z(70000, "b");
+    z.push_front("c");
+    z.push_back("a");
+    deque_stable_sort(z);
+    ASSERT_EQ(z.front(), "a");
+    ASSERT_EQ(z.back(), "c");
+}
+
+TEST(DequeSortTest, radix_sort) {
+    std::mt19937_64 g(3);
+    MyDeque<int> x;
+    std::vector<int> y;
+    for (int i = 0; i != 20000; ++i) {
+        y.push_back(static_cast<int>(g()) >> (i % 24));
+        x.push_back(y.back());}
+    deque_radix_sort(x);
+    std::sort(y.begin(), y.end());
+    ASSERT_TRUE(std::equal(x.begin(), x.end(), y.begin()));
+
+    MyDeque<double> d;
+    std::vector<double> e;
+    const double f[] = {0.0, -0.5, 3.25, -1e300, 1e-300, -2.0, 7.0, -0.0001};
+    for (int i = 0; i != 800; ++i) {
+        e.push_back(f[i % 8] * (i + 1));
+        d.push_front(e.back());}
+    deque_radix_sort(d);
+    std::sort(e.begin(), e.end());
+    ASSERT_TRUE(std::equal(d.begin(), d.end(), e.begin()));
+
+    typedef std::pair<std::string, long long> value_type;
+    MyDeque<value_type> p;
+    std::vector<value_type> q;
+    for (int i = 0; i != 3000; ++i) {
+        q.push_back(value_type(std::to_string(i), static_cast<long long>(g() % 50) - 25));
+        p.push_back(q.back());}
+    deque_radix_sort(p, [] (const value_type& v) {return v.second;});
+    std::stable_sort(q.begin(), q.end(), [] (const value_type& a, const value_type& b) {return a.second < b.second;});
+    ASSERT_TRUE(std::equal(p.begin(), p.end(), q.begin()));
+
+    MyDeque<unsigned> u(5, 9u);
+    deque_radix_sort(u);
+    ASSERT_TRUE(u == MyDeque<unsigned>(5, 9u));
+}
+
+// -----------------
+// AsyncDequeChannel
+// -----------------
+
+#if __cplusplus >= 202002L
+
+channel_task channel_produce (AsyncDequeChannel<int>* c, int b, int e, std::vector<int>* log) {
+    for (int i = b; i != e; ++i) {
+        const bool ok = co_await c->push(i);
+        if (log)
+            log->push_back(ok ? i : -1);}}
+
+channel_task channel_consume (AsyncDequeChannel<int>* c, std::vector<int>* out) {
+    for (;;) {
+        std::optional<int> v = co_await c->pop();
+        if (!v)
+            break;
+        out->push_back(*v);}
+    out->push_back(-1);}
+
+TEST(AsyncDequeChannelTest, single_thread) {
+    single_thread_executor e;
+    AsyncDequeChannel<int> c(e);
+    std::vector<int> out;
+    spawn(e, channel_consume(&c, &out));
+    e.run();
+    ASSERT_TRUE(out.empty());
+    spawn(e, channel_produce(&c, 0, 100, 0));
+    e.run();
+    ASSERT_EQ(out.size(), 100u);
+    for (int i = 0; i < 100; ++i)
+        ASSERT_EQ(out[i], i);
+    c.close();
+    e.run();
+    ASSERT_EQ(out.back(), -1);
+}
+
+TEST(AsyncDequeChannelTest, bounded) {
+    single_thread_executor e;
+    AsyncDequeChannel<int> c(e, 3);
+    std::vector<int> log;
+    spawn(e, channel_produce(&c, 0, 10, &log));
+    e.run();
+    ASSERT_EQ(log.size(), 3u);
+    ASSERT_EQ(c.size(), 3u);
+    ASSERT_EQ(*c.try_pop(), 0);
+    e.run();
+    ASSERT_EQ(log.size(), 4u);
+    ASSERT_EQ(c.size(), 3u);
+    std::vector<int> out;
+    spawn(e, channel_consume(&c, &out));
+    e.run();
+    ASSERT_EQ(out.size(), 9u);
+    ASSERT_EQ(out.front(), 1);
+    ASSERT_EQ(out.back(), 9);
+    c.close();
+    e.run();
+    ASSERT_EQ(out.back(), -1);
+    ASSERT_FALSE(c.try_pop());
+}
+
+TEST(AsyncDequeChannelTest, close_and_push_range) {
+    single_thread_executor e;
+    AsyncDequeChannel<int> c(e, 2);
+    std::vector<int> a, b, d;
+    spawn(e, channel_consume(&c, &a));
+    spawn(e, channel_consume(&c, &b));
+    e.run();
+    const int items[] = {1, 2, 3, 4, 5, 6};
+    ASSERT_EQ(c.push_range(items, items + 6), items + 4);
+    ASSERT_EQ(c.size(), 2u);
+    std::vector<int> log;
+    spawn(e, channel_produce(&c, 10, 12, &log));
+    c.close();
+    e.run();
+    ASSERT_EQ(log.size(), 2u);
+    ASSERT_EQ(log[0], -1);
+    ASSERT_EQ(a.front() + b.front(), 1 + 2);
+    spawn(e, channel_consume(&c, &d));
+    e.run();
+    ASSERT_EQ(d.size() + a.size() + b.size(), 4u + 3u);
+}
+
+channel_task channel_produce_mt (AsyncDequeChannel<int>* c, int b, int e, std::atomic<int>* left) {
+    for (int i = b; i != e; ++i)
+        co_await c->push(i);
+    if (--*left == 0)
+        c->close();}
+
+channel_task channel_consume_mt (AsyncDequeChannel<int>* c, std::atomic<long>* sum, std::atomic<int>* count, std::latch* done) {
+    for (;;) {
+        std::optional<int> v = co_await c->pop();
+        if (!v)
+            break;
+        *sum += *v;
+        ++*count;}
+    done->count_down();}
+
+TEST(AsyncDequeChannelTest, thread_pool) {
+    for (std::size_t capacity = 0; capacity < 20; capacity += 16) {
+        std::atomic<long> sum(0);
+        std::atomic<int> count(0);
+        std::atomic<int> left(4);
+        std::latch done(4);
+        std::unique_ptr<thread_pool_executor> e(new thread_pool_executor(4));
+        AsyncDequeChannel<int> c(*e, capacity);
+        for (int i = 0; i < 4; ++i)
+            spawn(*e, channel_consume_mt(&c, &sum, &count, &done));
+        for (int i = 0; i < 4; ++i)
+            spawn(*e, channel_produce_mt(&c, i * 10000, (i + 1) * 10000, &left));
+        done.wait();
+        e.reset();
+        ASSERT_EQ(count.load(), 40000);
+        ASSERT_EQ(sum.load(), 39999L * 40000 / 2);}
+}
+
+#endif
@@ -0,0 +1,674 @@
+// ------------------------------
+// projects/deque/TieredDeque.h
+// ------------------------------
+
+#ifndef TieredDeque_h
+#define TieredDeque_h
+
+// --------
+// includes
+// --------
+
+#include <cassert>   // assert
+#include <cstddef>   // size_t, ptrdiff_t
+#include <iterator>  // random_access_iterator_tag
+#include <memory>    // addressof
+#include <new>       // operator new, placement new
+#include <stdexcept> // out_of_range
+#include <type_traits> // is_nothrow_move_assignable, is_nothrow_move_constructible
+#include <utility>   // move, swap
+
+#include "Deque.h"
+
+// -----------
+// TieredDeque
+// -----------
+
+/**
+ * A deque with O(sqrt(n)) insert and erase anywhere and O(1) random access,
+ * after the tiered vector of Goodrich and Kloss. The elements live in rows
+ * of S, a power of 2, each row a circular buffer: every row is full except
+ * the first and the last, and the rows are held in a MyDeque.
+ *
+ * Inserting in the middle shifts elements within one row, at most S of them,
+ * and then passes one element along each row between it and the nearer end:
+ * a full row takes the carried element at one end and gives up the one at
+ * its other end, which is O(1) for a circular buffer. Erasing pulls one
+ * element back the same way. S doubles once there are 2 * S rows and halves
+ * once there are fewer than S / 8, rebuilding the rows each time, so S stays
+ * near sqrt(n) and a rebuild's O(n) moves are paid for by the O(n) pushes or
+ * pops since the last one.
+ *
+ * Pushes and pops at either end are O(1) amortized. Elements move within and
+ * between rows by move construction and assignment, which must not throw: an
+ * insert or erase holds the element it carries between rows outside of any
+ * row, and a move that threw there would lose it.
+ */
+template <typename T>
+class TieredDeque {
+    static_assert(std::is_nothrow_move_constructible<T>::value && std::is_nothrow_move_assignable<T>::value, "TieredDeque needs nothrow moves");
+
+    public:
+        // --------
+        // typedefs
+        // --------
+
+        typedef T                  value_type;
+        typedef std::size_t        size_type;
+        typedef std::ptrdiff_t     difference_type;
+        typedef T&                 reference;
+        typedef const T&           const_reference;
+
+        //log2 of the smallest row size.
+        const static size_type MIN_SHIFT = 4;
+
+    private:
+        /**
+         * A circular buffer of up to S elements; [head, head + n) mod S are live.
+         */
+        struct tier {
+            T*        data;
+            size_type head;
+            size_type n;};
+
+        // ----
+        // data
+        // ----
+
+        MyDeque<tier> _tiers;
+        size_type     _shift; // log2 of S
+        size_type     _size;
+
+    private:
+        // -----
+        // valid
+        // -----
+
+        bool valid () const {
+            size_type n = 0;
+            for (size_type r = 0; r != _tiers.size(); ++r) {
+                const size_type k = _tiers[r].n;
+                if (!k || k > row_size() || (k != row_size() && r && r + 1 != _tiers.size()))
+                    return false;
+                n += k;}
+            return (n == _size) && (_shift >= MIN_SHIFT);}
+
+        size_type mask () const {
+            return row_size() - 1;}
+
+        /**
+         * @return element k of row t
+         */
+        T* slot (const tier& t, size_type k) const {
+            return t.data + ((t.head + k) & mask());}
+
+        /**
+         * Adds an empty row at the back, or at the front if front is true.
+         */
+        tier& add_tier (bool front) {
+            tier t = {static_cast<T*>(::operator new(row_size() * sizeof(T))), 0, 0};
+            try {
+                if (front)
+                    _tiers.push_front(t);
+                else
+                    _tiers.push_back(t);}
+            catch (...) {
+                ::operator delete(t.data);
+                throw;}
+            return front ? _tiers.front() : _tiers.back();}
+
+        void delete_tier (tier& t) {
+            for (size_type k = 0; k != t.n; ++k)
+                slot(t, k)->~T();
+            ::operator delete(t.data);}
+
+        // ------------
+        // row push/pop
+        // ------------
+
+        template <typename V>
+        void tier_push_back (tier& t, V&& v) {
+            assert(t.n < row_size());
+            new (slot(t, t.n)) T(std::forward<V>(v));
+            ++t.n;}
+
+        template <typename V>
+        void tier_push_front (tier& t, V&& v) {
+            assert(t.n < row_size());
+            const size_type h = (t.head - 1) & mask();
+            new (t.data + h) T(std::forward<V>(v));
+            t.head = h;
+            ++t.n;}
+
+        T tier_pop_back (tier& t) {
+            T* p = slot(t, t.n - 1);
+            T v(std::move(*p));
+            p->~T();
+            --t.n;
+            return v;}
+
+        T tier_pop_front (tier& t) {
+            T* p = slot(t, 0);
+            T v(std::move(*p));
+            p->~T();
+            t.head = (t.head + 1) & mask();
+            --t.n;
+            return v;}
+
+        /**
+         * Inserts v before element k of the row t, which has room, shifting
+         * the elements on the shorter side of k by one.
+         */
+        void tier_insert (tier& t, size_type k, T&& v) {
+            assert(t.n < row_size() && k <= t.n);
+            if (k == 0)
+                tier_push_front(t, std::move(v));
+            else if (k < t.n / 2) {
+                tier_push_front(t, std::move(*slot(t, 0)));
+                for (size_type j = 1; j != k; ++j)
+                    *slot(t, j) = std::move(*slot(t, j + 1));
+                *slot(t, k) = std::move(v);}
+            else if (k == t.n)
+                tier_push_back(t, std::move(v));
+            else {
+                tier_push_back(t, std::move(*slot(t, t.n - 1)));
+                for (size_type j = t.n - 2; j != k; --j)
+                    *slot(t, j) = std::move(*slot(t, j - 1));
+                *slot(t, k) = std::move(v);}}
+
+        /**
+         * Removes element k of row t, closing the gap from the shorter side.
+         */
+        void tier_erase (tier& t, size_type k) {
+            assert(k < t.n);
+            if (k < t.n / 2) {
+                for (size_type j = k; j != 0; --j)
+                    *slot(t, j) = std::move(*slot(t, j - 1));
+                slot(t, 0)->~T();
+                t.head = (t.head + 1) & mask();}
+            else {
+                for (size_type j = k; j + 1 != t.n; ++j)
+                    *slot(t, j) = std::move(*slot(t, j + 1));
+                slot(t, t.n - 1)->~T();}
+            --t.n;}
+
+        /**
+         * Finds element i: row r, position k in it.
+         */
+        void locate (size_type i, size_type& r, size_type& k) const {
+            const size_type f = _tiers.front().n;
+            if (i < f) {
+                r = 0;
+                k = i;}
+            else {
+                i -= f;
+                r = 1 + (i >> _shift);
+                k = i & mask();}}
+
+        /**
+         * Moves every element into rows of 2 ** shift.
+         */
+        void rebuild (size_type shift) {
+            TieredDeque x;
+            x._shift = shift;
+            for (size_type r = 0; r != _tiers.size(); ++r) {
+                tier& t = _tiers[r];
+                for (size_type k = 0; k != t.n; ++k)
+                    x.push_back_value(std::move(*slot(t, k)), false);}
+            swap(x);}
+
+        /**
+         * Doubles or halves S if the number of rows has left [S / 8, 2 * S].
+         */
+        void resize_rows () {
+            if (_tiers.size() > 2 * row_size())
+                rebuild(_shift + 1);
+            else if (_shift > MIN_SHIFT && _tiers.size() < row_size() / 8)
+                rebuild(_shift - 1);}
+
+        template <typename V>
+        void push_back_value (V&& v, bool resize) {
+            if (_tiers.empty() || _tiers.back().n == row_size()) {
+                tier& t = add_tier(false);
+                try {
+                    tier_push_back(t, std::forward<V>(v));}
+                catch (...) {
+                    ::operator delete(t.data);
+                    _tiers.pop_back();
+                    throw;}}
+            else
+                tier_push_back(_tiers.back(), std::forward<V>(v));
+            ++_size;
+            if (resize)
+                resize_rows();
+            assert(valid());}
+
+        template <typename V>
+        void push_front_value (V&& v) {
+            if (_tiers.empty() || _tiers.front().n == row_size()) {
+                tier& t = add_tier(true);
+                try {
+                    tier_push_front(t, std::forward<V>(v));}
+                catch (...) {
+                    ::operator delete(t.data);
+                    _tiers.pop_front();
+                    throw;}}
+            else
+                tier_push_front(_tiers.front(), std::forward<V>(v));
+            ++_size;
+            resize_rows();
+            assert(valid());}
+
+    public:
+        // ---------
+        // iterators
+        // ---------
+
+        /**
+         * A position in a TieredDeque, kept as an index, so it is invalidated
+         * only by a rebuild changing what the index refers to, as any insert
+         * or erase before it does.
+         */
+        template <typename D, typename V>
+        class index_iterator {
+            public:
+                // --------
+                // typedefs
+                // --------
+
+                typedef std::random_access_iterator_tag iterator_category;
+                typedef T                               value_type;
+                typedef std::ptrdiff_t                  difference_type;
+                typedef V*                              pointer;
+                typedef V&                              reference;
+
+            public:
+                friend bool operator == (const index_iterator& lhs, const index_iterator& rhs) {
+                    return lhs._i == rhs._i;}
+
+                friend bool operator != (const index_iterator& lhs, const index_iterator& rhs) {
+                    return !(lhs == rhs);}
+
+                friend bool operator < (const index_iterator& lhs, const index_iterator& rhs) {
+                    return lhs._i < rhs._i;}
+
+                friend bool operator > (const index_iterator& lhs, const index_iterator& rhs) {
+                    return rhs < lhs;}
+
+                friend bool operator <= (const index_iterator& lhs, const index_iterator& rhs) {
+                    return !(rhs < lhs);}
+
+                friend bool operator >= (const index_iterator& lhs, const index_iterator& rhs) {
+                    return !(lhs < rhs);}
+
+                friend index_iterator operator + (index_iterator lhs, difference_type rhs) {
+                    return lhs += rhs;}
+
+                friend index_iterator operator + (difference_type lhs, index_iterator rhs) {
+                    return rhs += lhs;}
+
+                friend index_iterator operator - (index_iterator lhs, difference_type rhs) {
+                    return lhs -= rhs;}
+
+                friend difference_type operator - (const index_iterator& lhs, const index_iterator& rhs) {
+                    return static_cast<difference_type>(lhs._i) - static_cast<difference_type>(rhs._i);}
+
+            private:
+                friend class TieredDeque;
+
+                // ----
+                // data
+                // ----
+
+                D*        _d;
+                size_type _i;
+
+            public:
+                index_iterator () :
+                        _d(0),
+                        _i(0)
+                    {}
+
+                index_iterator (D* d, size_type i) :
+                        _d(d),
+                        _i(i)
+                    {}
+
+                /**
+                 * iterator to const_iterator
+                 */
+                template <typename E, typename W>
+                index_iterator (const index_iterator<E, W>& that) :
+                        _d(that._d),
+                        _i(that._i)
+                    {}
+
+                reference operator * () const {
+                    return (*_d)[_i];}
+
+                pointer operator -> () const {
+                    return std::addressof(**this);}
+
+                reference operator [] (difference_type n) const {
+                    return (*_d)[_i + n];}
+
+                index_iterator& operator ++ () {
+                    ++_i;
+                    return *this;}
+
+                index_iterator operator ++ (int) {
+                    index_iterator x = *this;
+                    ++_i;
+                    return x;}
+
+                index_iterator& operator -- () {
+                    --_i;
+                    return *this;}
+
+                index_iterator operator -- (int) {
+                    index_iterator x = *this;
+                    --_i;
+                    return x;}
+
+                index_iterator& operator += (difference_type n) {
+                    _i += n;
+                    return *this;}
+
+                index_iterator& operator -= (difference_type n) {
+                    _i -= n;
+                    return *this;}
+
+                template <typename E, typename W>
+                friend class index_iterator;};
+
+        typedef index_iterator<TieredDeque, T>             iterator;
+        typedef index_iterator<const TieredDeque, const T> const_iterator;
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        TieredDeque () :
+                _shift(MIN_SHIFT),
+                _size(0)
+            {}
+
+        TieredDeque (const TieredDeque& that) :
+                _shift(that._shift),
+                _size(0) {
+            try {
+                for (size_type i = 0; i != that._size; ++i)
+                    push_back_value(that[i], false);}
+            catch (...) {
+                clear();
+                throw;}}
+
+        // ----------
+        // destructor
+        // ----------
+
+        ~TieredDeque () {
+            clear();}
+
+        // ----------
+        // operator =
+        // ----------
+
+        TieredDeque& operator = (const TieredDeque& that) {
+            TieredDeque x(that);
+            swap(x);
+            return *this;}
+
+        // -----------
+        // operator []
+        // -----------
+
+        reference operator [] (size_type i) {
+            size_type r, k;
+            locate(i, r, k);
+            return *slot(_tiers[r], k);}
+
+        const_reference operator [] (size_type i) const {
+            size_type r, k;
+            locate(i, r, k);
+            return *slot(_tiers[r], k);}
+
+        // --
+        // at
+        // --
+
+        /**
+         * @throws out_of_range exception
+         */
+        reference at (size_type i) {
+            if (i >= _size)
+                throw std::out_of_range("TieredDeque::at()");
+            return (*this)[i];}
+
+        /**
+         * @throws out_of_range exception
+         */
+        const_reference at (size_type i) const {
+            if (i >= _size)
+                throw std::out_of_range("TieredDeque::at()");
+            return (*this)[i];}
+
+        // ----------
+        // back/front
+        // ----------
+
+        reference back () {
+            const tier& t = _tiers.back();
+            return *slot(t, t.n - 1);}
+
+        const_reference back () const {
+            const tier& t = _tiers.back();
+            return *slot(t, t.n - 1);}
+
+        reference front () {
+            return *slot(_tiers.front(), 0);}
+
+        const_reference front () const {
+            return *slot(_tiers.front(), 0);}
+
+        // ---------
+        // begin/end
+        // ---------
+
+        iterator begin () {
+            return iterator(this, 0);}
+
+        const_iterator begin () const {
+            return const_iterator(this, 0);}
+
+        iterator end () {
+            return iterator(this, _size);}
+
+        const_iterator end () const {
+            return const_iterator(this, _size);}
+
+        // -----
+        // clear
+        // -----
+
+        void clear () {
+            for (size_type r = 0; r != _tiers.size(); ++r)
+                delete_tier(_tiers[r]);
+            _tiers.clear();
+            _size = 0;}
+
+        // -----
+        // empty
+        // -----
+
+        bool empty () const {
+            return !_size;}
+
+        // -----
+        // erase
+        // -----
+
+        /**
+         * Removes the element at loc, shifting within its row and then
+         * pulling one element along each row toward the nearer end.
+         * @return iterator to the element after it
+         */
+        iterator erase (iterator loc) {
+            const size_type i = loc._i;
+            assert(i < _size);
+            size_type r, k;
+            locate(i, r, k);
+            tier_erase(_tiers[r], k);
+            const size_type last = _tiers.size() - 1;
+            if (r && r != last) {
+                if (r >= _tiers.size() / 2)
+                    for (size_type q = r; q != last; ++q)
+                        tier_push_back(_tiers[q], tier_pop_front(_tiers[q + 1]));
+                else
+                    for (size_type q = r; q != 0; --q)
+                        tier_push_front(_tiers[q], tier_pop_back(_tiers[q - 1]));}
+            if (!_tiers.back().n) {
+                ::operator delete(_tiers.back().data);
+                _tiers.pop_back();}
+            else if (!_tiers.front().n) {
+                ::operator delete(_tiers.front().data);
+                _tiers.pop_front();}
+            --_size;
+            resize_rows();
+            assert(valid());
+            return iterator(this, i);}
+
+        // ------
+        // insert
+        // ------
+
+        /**
+         * Inserts val before loc. When loc's row is full, the element at one
+         * end of it is carried along the rows toward the nearer end of the
+         * deque, each full row passing on its own end element in turn.
+         * @return iterator to the new element
+         */
+        iterator insert (iterator loc, const_reference val) {
+            const size_type i = loc._i;
+            assert(i <= _size);
+            if (i == _size) {
+                push_back(val);
+                return iterator(this, i);}
+            if (i == 0) {
+                push_front(val);
+                return begin();}
+            T v(val);
+            size_type r, k;
+            locate(i, r, k);
+            if (_tiers[r].n < row_size())
+                tier_insert(_tiers[r], k, std::move(v));
+            else if (!k && _tiers[r - 1].n < row_size())
+                tier_push_back(_tiers[r - 1], std::move(v));
+            else if (r >= _tiers.size() / 2) {
+                T carry(tier_pop_back(_tiers[r]));
+                tier_insert(_tiers[r], k, std::move(v));
+                size_type q = r + 1;
+                for (; q != _tiers.size() && _tiers[q].n == row_size(); ++q) {
+                    T next(tier_pop_back(_tiers[q]));
+                    tier_push_front(_tiers[q], std::move(carry));
+                    carry = std::move(next);}
+                if (q != _tiers.size())
+                    tier_push_front(_tiers[q], std::move(carry));
+                else {
+                    push_back_value(std::move(carry), false);
+                    --_size;}}
+            else {
+                T carry(k ? tier_pop_front(_tiers[r]) : std::move(v));
+                if (k)
+                    tier_insert(_tiers[r], k - 1, std::move(v));
+                size_type q = r;
+                for (; q != 0 && _tiers[q - 1].n == row_size(); --q) {
+                    T next(tier_pop_front(_tiers[q - 1]));
+                    tier_push_back(_tiers[q - 1], std::move(carry));
+                    carry = std::move(next);}
+                if (q != 0)
+                    tier_push_back(_tiers[q - 1], std::move(carry));
+                else {
+                    push_front_value(std::move(carry));
+                    --_size;}}
+            ++_size;
+            resize_rows();
+            assert(valid());
+            return iterator(this, i);}
+
+        // ---
+        // pop
+        // ---
+
+        void pop_back () {
+            tier& t = _tiers.back();
+            slot(t, t.n - 1)->~T();
+            if (!--t.n) {
+                ::operator delete(t.data);
+                _tiers.pop_back();}
+            --_size;
+            resize_rows();
+            assert(valid());}
+
+        void pop_front () {
+            tier& t = _tiers.front();
+            slot(t, 0)->~T();
+            t.head = (t.head + 1) & mask();
+            if (!--t.n) {
+                ::operator delete(t.data);
+                _tiers.pop_front();}
+            --_size;
+            resize_rows();
+            assert(valid());}
+
+        // ----
+        // push
+        // ----
+
+        void push_back (const_reference v) {
+            push_back_value(v, true);}
+
+        void push_front (const_reference v) {
+            push_front_value(v);}
+
+        // ----
+        // rows
+        // ----
+
+        /**
+         * @return the number of rows, near sqrt(size())
+         */
+        size_type rows () const {
+            return _tiers.size();}
+
+        // --------
+        // row_size
+        // --------
+
+        /**
+         * @return S, the capacity of every row
+         */
+        size_type row_size () const {
+            return size_type(1) << _shift;}
+
+        // ----
+        // size
+        // ----
+
+        size_type size () const {
+            return _size;}
+
+        // ----
+        // swap
+        // ----
+
+        void swap (TieredDeque& that) {
+            _tiers.swap(that._tiers);
+            std::swap(_shift, that._shift);
+            std::swap(_size, that._size);}};
+
+template <typename T>
+const typename TieredDeque<T>::size_type TieredDeque<T>::MIN_SHIFT;
+
+#endif // TieredDeque_h